@@ -4,11 +4,48 @@
 #include <stdbool.h>
 #include <math.h>
 #include <time.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <glob.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define MAX_STRING 256
-#define B_PLUS_TREE_ORDER 5  // Order of B+ Tree
+#ifndef B_PLUS_TREE_ORDER
+#define B_PLUS_TREE_ORDER 13  // Order of B+ Tree - 13 makes a node exactly five cache lines
+#endif
+#if B_PLUS_TREE_ORDER < 4
+#error "B_PLUS_TREE_ORDER must be at least 4"
+#endif
+#define KEY_BYTES 16  // Width of a normalized tree key - longer IDs are rejected
+#define CACHE_LINE_SIZE 64
+#define CUSTOMER_NAME_LENGTH 64
+#define MOBILE_NO_LENGTH 16
+#define ADDRESS_LENGTH 128
+#define PAYMENT_TYPE_LENGTH 32
+#define BULK_LOAD_FILL_FACTOR 1.0  // Fraction of each node filled when building trees in bulk
+#define SLAB_BYTES (64 * 1024)  // Size of one slab pool block
+#define MAX_WORKER_THREADS 64  // Upper bound on threads used by parallelFor
+#define WORKER_THREADS_ENV "SHOWROOM_THREADS"  // Overrides the online core count
+#define LOAD_CHUNK_BYTES (1024 * 1024)  // Smallest piece of a data file parsed as one task
+#define CAR_SALE_SEGMENT_SHIFT 16  // Sale records per segment, as a power of two
+#define MAX_CAR_SALE_SEGMENTS 65536  // Enough segments for every 32-bit sale index
 #define MIN_DOWN_PAYMENT_PERCENT 20.0
 #define COMMISSION_RATE 0.02  // 2% commission
+#define INCENTIVE_RATE 0.01  // 1% incentive for the most successful salesperson
 
 // File paths
 #define CAR_DATA_FILE "car_data.dat"
@@ -16,6 +53,64 @@
 #define CUSTOMER_DATA_FILE "customer_data.dat"
 #define SALES_DATA_FILE "sales_data.dat"
 #define SHOWROOM_DATA_FILE "showroom_data.dat"
+#define JOURNAL_FILE "journal.dat"
+#define SNAPSHOT_FILE "showroom.snap"
+#define SHOWROOM_FEED_PATTERN "showroom*.dat"  // Per-showroom car feeds, each sorted by VIN
+
+// Showroom merge
+#define MERGE_OUTPUT_BUFFER (1024 * 1024)  // stdio buffer for the merged file
+#define MERGE_PREFETCH_LINES 2  // Cache lines of a feed requested ahead of its next record
+#define SORT_MEMORY_BUDGET (256UL * 1024 * 1024)  // Default memory for sorting unsorted feeds
+#define SORT_MEMORY_ENV "SHOWROOM_SORT_MB"  // Overrides the sort memory budget, in megabytes
+#define SORT_MIN_RUN_BYTES (1024 * 1024)
+#define SORT_RUN_TEMPLATE "sortrun.XXXXXX"  // Temporary run files, in the working directory
+
+// Script mode
+#define SCRIPT_OUTPUT_BUFFER (1024 * 1024)  // stdout buffer while running a script
+
+// Server mode
+#define SERVER_SOCKET_PATH "showroom.sock"  // Default socket, in the working directory
+#define SERVER_RESPONSE_END "END"  // Line that closes every response
+#define SERVER_BACKLOG 128
+#define SERVER_MAX_EVENTS 64
+#define SERVER_TICK_MS 1000  // Longest wait of the event loop between metrics exports
+#define SERVER_READ_BUFFER 4096  // Bytes read from a client per turn
+#define SERVER_MAX_REQUEST (64 * 1024)  // Longest request line accepted
+
+// Data generator and benchmarks
+#define GENERATOR_SEED 0x5EEDULL  // Fixed so a given size always gives the same files
+#define GENERATOR_ZIPF_EXPONENT 1.1  // Skew of model popularity
+#define GENERATOR_SOLD_PERCENT 30
+#define GENERATOR_LOAN_PERCENT 60  // Share of sold cars bought on loan
+#define GENERATOR_MAX_CARS 99999999  // VINs are CAR and eight digits
+#define GENERATOR_MAX_SHOWROOMS 500  // Every feed file is open while cars are written
+#define GENERATOR_OUTPUT_BUFFER (1024 * 1024)
+#define GENERATOR_FEED_BUFFER (64 * 1024)
+#define BENCH_LOOKUPS 100000  // Default number of timed VIN lookups
+#define BENCH_SALES 1000
+#define BENCH_SCAN_REPEATS 10  // Runs of each full-scan report
+#define BENCH_MERGE_REPEATS 3
+#define BENCH_MERGE_FILE "bench_merge.tmp"
+#define TREE_BENCH_KEYS 1000000  // Default keys per tree for --bench-tree
+#define STRESS_TREE_THREADS 8  // Default threads for --stress-tree, more than cores is fine
+#define STRESS_TREE_KEYS 1000000
+#define STRESS_TREE_DELETE_EVERY 8  // Share of its keys each stress thread deletes again
+
+// Binary snapshot format
+#define SNAPSHOT_MAGIC "CARSNAP"  // 8 bytes including the terminator
+#define SNAPSHOT_VERSION 5
+#define SNAPSHOT_ALIGNMENT 64  // Sections start on a cache line
+#define SNAPSHOT_BASE_ADDRESS 0x600000000000ULL  // Mapping address the stored list links are valid for
+
+// Metrics
+#define METRIC_BUCKETS 64  // log2 latency buckets, 1 ns to centuries
+#define METRIC_SAMPLE_RATE 16  // Tree searches and inserts time one call in this many
+#define METRICS_FILE_ENV "SHOWROOM_METRICS_FILE"  // Prometheus text export, off when unset
+#define METRICS_INTERVAL_ENV "SHOWROOM_METRICS_INTERVAL"  // Seconds between exports
+#define METRICS_EXPORT_INTERVAL 10
+
+// Journal compaction
+#define JOURNAL_COMPACT_THRESHOLD 10000  // Rewrite data files, between operations, after this many journal records
 
 // Forward declarations
 typedef struct BPlusTreeNode BPlusTreeNode;
@@ -23,27 +118,54 @@ typedef struct CarNode CarNode;
 typedef struct SalesPersonNode SalesPersonNode;
 typedef struct CustomerNode CustomerNode;
 
+// Interned strings - a dictionary maps each distinct value to a small code
+typedef uint16_t DictCode;
+#define MAX_DICTIONARY_CODES 65536
+
+typedef struct StringDictionary {
+    char** values;  // Code -> string, code 0 is always ""
+    uint32_t* slots;  // Open addressing on the string hash, code + 1 (0 = empty)
+    size_t count;
+    size_t capacity;
+    size_t numSlots;  // Always a power of two
+} StringDictionary;
+
+// Low-cardinality car attributes, one dictionary each
+typedef enum CarDictionary {
+    DICT_MODEL,
+    DICT_COLOR,
+    DICT_FUEL_TYPE,
+    DICT_BODY_TYPE,
+    DICT_SHOWROOM,
+    DICT_PAYMENT_TYPE,
+    NUM_CAR_DICTIONARIES
+} CarDictionary;
+
 // Data structures
+// Cars are compact fixed-size records: attributes are dictionary codes and the
+// sale details of a sold car live in the carSaleSegments side array
 typedef struct Car {
-    char VIN[MAX_STRING];  // Primary key
-    char name[MAX_STRING];
-    char color[MAX_STRING];
     double price;
-    char fuelType[MAX_STRING];
-    char bodyType[MAX_STRING];  // Hatchback, Sedan or SUV
-    char showroomId[MAX_STRING];
+    uint32_t saleIndex;  // 1-based index of the sale record, 0 while available
+    DictCode name;  // Model
+    DictCode color;
+    DictCode fuelType;
+    DictCode bodyType;  // Hatchback, Sedan or SUV
+    DictCode showroomId;
+    char VIN[KEY_BYTES + 1];  // Primary key
     bool available;  // true if available, false if sold
-    
-    // For sold cars
-    char customerId[MAX_STRING];
-    char salesPersonId[MAX_STRING];
-    char paymentType[MAX_STRING];  // Cash/Loan
+} Car;
+
+typedef struct CarSale {
+    char customerId[KEY_BYTES + 1];
+    char salesPersonId[KEY_BYTES + 1];
+    DictCode paymentType;  // Cash/Loan
     
     // For EMI payments
     int emiMonths;
     double downPayment;
     double emiRate;
-} Car;
+} CarSale;
 
 typedef struct SalesPerson {
     char id[MAX_STRING];  // Primary key
@@ -55,34 +177,215 @@ typedef struct SalesPerson {
 } SalesPerson;
 
 typedef struct Customer {
-    char id[MAX_STRING];  // Primary key
-    char name[MAX_STRING];
-    char mobileNo[MAX_STRING];
-    char address[MAX_STRING];
-    int numPurchasedCars;
-    char purchasedCars[10][MAX_STRING];  // Assuming max 10 cars per customer - Array of VINs
+    char id[KEY_BYTES + 1];  // Primary key
+    char name[CUSTOMER_NAME_LENGTH];
+    char mobileNo[MOBILE_NO_LENGTH];
+    char address[ADDRESS_LENGTH];
+    uint32_t numPurchasedCars;
+    uint32_t firstPurchase;  // 1-based index into purchases, 0 if none
+    uint32_t lastPurchase;
 } Customer;
 
+// One car in a customer's purchase history, linked in purchase order
+typedef struct Purchase {
+    char VIN[KEY_BYTES + 1];
+    uint32_t next;  // 1-based index of the customer's next purchase, 0 at the end
+} Purchase;
+
+// One sale of a batch - the arguments of sellCarToCustomer
+typedef struct SaleRequest {
+    char VIN[KEY_BYTES + 1];
+    char customerId[KEY_BYTES + 1];
+    char salesPersonId[KEY_BYTES + 1];
+    char paymentType[PAYMENT_TYPE_LENGTH];
+    int emiMonths;
+    double downPayment;
+} SaleRequest;
+
+typedef enum SaleStatus {
+    SALE_OK,
+    SALE_CAR_NOT_FOUND,
+    SALE_CAR_ALREADY_SOLD,
+    SALE_CAR_REPEATED,  // The car is sold by an earlier sale of the same batch
+    SALE_CUSTOMER_NOT_FOUND,
+    SALE_SALES_PERSON_NOT_FOUND,
+    SALE_DOWN_PAYMENT_TOO_LOW,
+    SALE_BATCH_REJECTED  // Valid, but another sale of the batch was not
+} SaleStatus;
+
+typedef struct PurchasePool {
+    Purchase* items;
+    size_t count;
+    size_t capacity;
+} PurchasePool;
+
 typedef struct Showroom {
     char id[MAX_STRING];  // Primary key
     char name[MAX_STRING];
     char manufacturer[MAX_STRING];
 } Showroom;
 
+// Running totals of one showroom's cars, kept up to date as cars are added and sold
+typedef struct ShowroomStats {
+    size_t numCars;
+    size_t numSold;
+    double totalValue;  // Price total of every car, in rupees
+    double soldValue;  // Price total of the sold ones
+} ShowroomStats;
+
+// Index key orders a snapshot stores, so loading builds the trees without sorting
+typedef enum IndexOrder {
+    ORDER_CAR_VIN,
+    ORDER_SALESPERSON_ID,
+    ORDER_SALESPERSON_ACHIEVED,
+    ORDER_CUSTOMER_ID,
+    ORDER_LOAN_EMI,  // Cars bought on a loan only
+    NUM_INDEX_ORDERS
+} IndexOrder;
+
+// Binary snapshot header - all offsets are from the start of the file
+typedef struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t showroomRecordSize;
+    uint32_t carRecordSize;
+    uint32_t salesPersonRecordSize;
+    uint32_t customerRecordSize;
+    uint64_t numShowrooms;
+    uint64_t numCars;
+    uint64_t numSalesPersons;
+    uint64_t numCustomers;
+    uint64_t showroomOffset;
+    uint64_t carOffset;
+    uint64_t salesPersonOffset;
+    uint64_t customerOffset;
+    uint32_t saleRecordSize;
+    uint32_t numDictionaries;
+    uint64_t numSales;
+    uint64_t saleOffset;
+    uint64_t dictionaryOffset;  // Dictionary strings in code order, NUL-terminated
+    uint64_t dictionarySize;
+    uint64_t dictionaryCounts[NUM_CAR_DICTIONARIES];
+    uint64_t purchaseRecordSize;
+    uint64_t numPurchases;
+    uint64_t purchaseOffset;
+    uint64_t orderOffsets[NUM_INDEX_ORDERS];  // List positions as uint32_t, in key order
+    uint64_t orderCounts[NUM_INDEX_ORDERS];
+    uint64_t fileSize;
+} SnapshotHeader;
+
+// The records of a loaded snapshot and its stored key orders, to build the indexes from
+typedef struct SnapshotIndexes {
+    CarNode* cars;
+    SalesPersonNode* salesPersons;
+    CustomerNode* customers;
+    const uint32_t* orders[NUM_INDEX_ORDERS];
+    size_t orderCounts[NUM_INDEX_ORDERS];
+} SnapshotIndexes;
+
 // B+ Tree Structures
+// Normalized fixed-width key - the first KEY_BYTES bytes of the ID, big-endian
+typedef struct BPlusKey {
+    uint64_t hi;
+    uint64_t lo;
+} BPlusKey;
+
+// Keys come first so a node scan reads consecutive cache lines
 struct BPlusTreeNode {
-    bool isLeaf;
-    int numKeys;
-    char keys[B_PLUS_TREE_ORDER - 1][MAX_STRING];  // Using VIN as key
-    BPlusTreeNode* next; // For leaf nodes to link to the next leaf
-    BPlusTreeNode* parent; // Added parent pointer for easier navigation
+    BPlusKey keys[B_PLUS_TREE_ORDER - 1];  // Using VIN as key
     
     // Union for pointer types
     union {
         BPlusTreeNode* children[B_PLUS_TREE_ORDER];
         void* dataPointers[B_PLUS_TREE_ORDER - 1];
     };
-};
+    
+    BPlusTreeNode* next; // For leaf nodes to link to the next leaf
+    BPlusTreeNode* parent; // Added parent pointer for easier navigation
+    atomic_uint version;  // Odd while a writer holds the node, see Optimistic lock coupling
+    uint16_t numKeys;  // Narrow so the version fits in what was padding
+    bool isLeaf;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// Position in a tree's leaf chain for range and prefix scans
+typedef struct TreeCursor {
+    BPlusTreeNode* leaf;
+    int position;
+    BPlusKey endKey;  // Inclusive upper bound when bounded
+    bool bounded;
+} TreeCursor;
+
+// Forward scan that may run while other threads insert, see Shared scans
+typedef struct SharedTreeCursor {
+    BPlusTreeNode* const* rootPtr;
+    BPlusTreeNode* leaf;  // NULL when the next step has to descend from the root
+    unsigned version;  // Of leaf when the cursor moved onto it
+    int position;
+    BPlusKey resumeKey;  // Smallest key not returned yet
+    BPlusKey endKey;  // Inclusive
+    bool finished;
+} SharedTreeCursor;
+
+// Shape of a tree, gathered by validateTree
+typedef struct TreeStats {
+    size_t height;  // Levels, 0 for an empty tree
+    size_t numNodes;
+    size_t numLeaves;
+    size_t numKeys;  // Keys in the leaves
+} TreeStats;
+
+// One field of a CSV row - points into the reader's buffer, not NUL-terminated
+typedef struct FieldView {
+    const char* start;
+    size_t length;
+} FieldView;
+
+// Streaming reader over a memory-mapped comma-separated file
+typedef struct CsvReader {
+    void* mapping;
+    const char* data;
+    size_t size;
+    size_t position;  // Start of the next row
+    FieldView* fields;  // Fields of the current row
+    size_t numFields;
+    size_t fieldCapacity;
+} CsvReader;
+
+// One sorted input of a merge and its current line
+typedef struct MergeSource {
+    CsvReader reader;  // Mapping of the file, read line by line
+    const char* line;  // Current line without its terminator
+    size_t length;
+    bool newlineFollows;  // The line ends in a bare '\n' that can be copied with it
+    BPlusKey key;  // First KEY_BYTES bytes of the first field
+    size_t keyLength;  // Bytes before the first comma
+    size_t index;  // Position in the input list, breaks ties
+} MergeSource;
+
+// One line of a run being sorted in memory
+typedef struct SortLine {
+    BPlusKey key;
+    const char* line;
+    uint32_t length;
+    uint32_t keyLength;
+} SortLine;
+
+// A line-aligned slice of a sort input and, once sorted, where it was spilled
+typedef struct SortRun {
+    const char* data;
+    size_t size;
+    bool spilled;  // Sorted into fileName - runs already in order are merged in place
+    bool failed;
+    char fileName[32];
+} SortRun;
+
+// Key/value pair handed to the bulk loader
+typedef struct TreeEntry {
+    BPlusKey key;
+    void* value;
+    size_t seq;  // Tie-break for duplicate keys - the lowest sequence number wins
+} TreeEntry;
 
 // Specific node types for our data
 struct CarNode {
@@ -90,9 +393,17 @@ struct CarNode {
     struct CarNode* next;
 };
 
+// Achieved total of a salesperson before one sale, kept while a snapshot may need it
+typedef struct AchievedVersion {
+    size_t sequence;  // Sale index of the sale that changed the total
+    double before;
+    struct AchievedVersion* older;
+} AchievedVersion;
+
 struct SalesPersonNode {
     SalesPerson salesPerson;
     struct SalesPersonNode* next;
+    AchievedVersion* history;  // Newest first, see Sale snapshots
 };
 
 struct CustomerNode {
@@ -100,1171 +411,6707 @@ struct CustomerNode {
     struct CustomerNode* next;
 };
 
+// A loan sale joined to its customer, as stored in loanEmiTree
+typedef struct LoanSale {
+    CarNode* car;
+    CustomerNode* customer;  // NULL if the customer was not loaded when the sale was indexed
+} LoanSale;
+
+// A report's view of the sales committed when it began
+typedef struct SaleSnapshot {
+    size_t sequence;  // Sales committed, so sale indexes 1..sequence are visible
+    struct SaleSnapshot* prev;
+    struct SaleSnapshot* next;
+} SaleSnapshot;
+
+// Slab pool for one object type - objects are carved from SLAB_BYTES blocks
+typedef struct Slab {
+    struct Slab* next;
+} Slab;
+
+typedef struct SlabPool {
+    const char* name;
+    size_t objectSize;
+    size_t alignment;
+    Slab* slabs;  // Newest first
+    char* cursor;  // Next free object in the newest slab
+    char* limit;
+    size_t numSlabs;
+    size_t numObjects;
+    pthread_mutex_t lock;  // Trees built on separate threads share the node pool
+} SlabPool;
+
+#define SLAB_POOL(label, type) { label, sizeof(type), _Alignof(type), NULL, NULL, NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER }
+
+// One loop run by parallelFor
+typedef void (*ParallelTask)(void* context, size_t index);
+
+typedef struct ParallelLoop {
+    ParallelTask task;
+    void* context;
+    size_t count;
+    atomic_size_t next;  // Next index to hand out
+} ParallelLoop;
+
+// Timed operations and counted events
+typedef enum MetricTimer {
+    METRIC_SEARCH,
+    METRIC_INSERT,
+    METRIC_SELL,
+    METRIC_SELL_BATCH,
+    METRIC_LOAD,
+    METRIC_JOURNAL_REPLAY,
+    METRIC_COMPACT,
+    METRIC_MERGE,
+    NUM_METRIC_TIMERS
+} MetricTimer;
+
+typedef enum MetricCounter {
+    METRIC_LEAF_SPLITS,
+    METRIC_INTERNAL_SPLITS,
+    METRIC_BYTES_WRITTEN,
+    METRIC_FILES_OPENED,
+    NUM_METRIC_COUNTERS
+} MetricCounter;
+
+typedef struct LatencyHistogram {
+    atomic_uint_fast64_t buckets[METRIC_BUCKETS];
+    atomic_uint_fast64_t count;
+    atomic_uint_fast64_t sumNanos;
+} LatencyHistogram;
+
+// A line-aligned piece of a data file and the records parsed from it
+typedef enum DataFileType {
+    DATA_CARS,
+    DATA_SALES_PERSONS,
+    DATA_CUSTOMERS,
+    NUM_DATA_FILES
+} DataFileType;
+
+typedef struct LoadChunk {
+    DataFileType type;
+    const char* data;
+    size_t size;
+    SlabPool nodes;  // CarNode, SalesPersonNode or CustomerNode records
+    void* head;  // Chunk's records linked newest first, as on the global lists
+    void* tail;
+    CarSale* sales;  // Sale details of sold cars, indexed by their saleIndex
+    size_t numSales;
+    size_t saleCapacity;
+    size_t saleBase;  // Index of sales[0] among all sale records
+    StringDictionary dictionaries[NUM_CAR_DICTIONARIES];  // Codes used by this chunk's cars
+    DictCode* codes[NUM_CAR_DICTIONARIES];  // Chunk code -> global code
+    PurchasePool purchases;  // Indexed by this chunk's customers
+    size_t purchaseBase;  // Position of purchases.items[0] in purchasePool
+} LoadChunk;
+
+// Fields cars can be grouped and counted by
+typedef enum CarGroupField {
+    GROUP_BY_MODEL,
+    GROUP_BY_COLOR,
+    GROUP_BY_FUEL_TYPE,
+    GROUP_BY_BODY_TYPE,
+    GROUP_BY_SHOWROOM
+} CarGroupField;
+
+// One distinct value and its count in a group-by hash table
+typedef struct GroupCount {
+    const char* key;  // NULL for an empty slot
+    uint64_t hash;
+    size_t count;
+    size_t firstSeen;  // Order of first appearance, used to break ties
+} GroupCount;
+
+typedef struct GroupCountTable {
+    GroupCount* slots;
+    size_t capacity;  // Always a power of two
+    size_t size;
+} GroupCountTable;
+
+// One command of a script: its name, the fields it takes and what runs it
+typedef void (*ScriptHandler)(FILE* out, const FieldView* args, size_t numArgs);
+
+// What a command touches, which decides what it may overlap in server mode
+typedef enum CommandAccess {
+    ACCESS_READ,  // Reads the live store, alongside other reads
+    ACCESS_SNAPSHOT,  // Reads only what sales leave alone or a sale snapshot, so sales go on meanwhile
+    ACCESS_SALE,  // Sells cars
+    ACCESS_WRITE  // Adds records or rewrites the data files
+} CommandAccess;
+
+typedef struct ScriptCommand {
+    const char* name;
+    const char* usage;  // Fields after the name
+    size_t minArgs;
+    ScriptHandler handler;
+    CommandAccess access;
+} ScriptCommand;
+
+// A connection of server mode and the part of its input not yet run
+typedef struct ServerClient {
+    int fd;
+    char* pending;  // Received bytes not yet run, starting at a request line
+    size_t length;
+    size_t capacity;
+    struct ServerClient* prev;  // Links of the list of connected clients
+    struct ServerClient* next;
+    struct ServerClient* nextReady;  // Link of the queue waiting for a worker
+} ServerClient;
+
+// Clients of server mode and the queue of those with input for a worker
+typedef struct Server {
+    int listenFd;
+    int epollFd;
+    ServerClient* clients;
+    ServerClient* readyHead;
+    ServerClient* readyTail;
+    bool exportPending;  // The next free worker exports the metrics
+    bool stopping;
+    pthread_mutex_t lock;  // Guards the client list, the ready queue and the flags
+    pthread_cond_t hasWork;
+} Server;
+
+// Number of records of each kind written by the data generator
+typedef struct DatasetSize {
+    size_t cars;
+    size_t customers;
+    size_t salesPersons;
+    size_t showrooms;
+} DatasetSize;
+
+// Operations timed by the benchmark driver
+typedef enum BenchmarkId {
+    BENCH_LOAD,
+    BENCH_SEARCH,
+    BENCH_SELL,
+    BENCH_POPULAR,
+    BENCH_EMI_RANGE,
+    BENCH_MERGE,
+    NUM_BENCHMARKS
+} BenchmarkId;
+
+// Key sets the tree benchmark builds trees from
+typedef enum KeyDistribution {
+    KEYS_SEQUENTIAL,
+    KEYS_RANDOM,
+    KEYS_PREFIX_HEAVY,
+    NUM_KEY_DISTRIBUTIONS
+} KeyDistribution;
+
+// One thread of the tree stress test and what it saw
+typedef struct StressWorker {
+    BPlusTreeNode** rootPtr;
+    const BPlusKey* keys;
+    size_t numKeys;
+    size_t thread;
+    size_t numThreads;  // Threads that built the tree, which decides the deleted keys
+    size_t operations;  // Done while building, or lookups to do when timing
+    size_t errors;
+} StressWorker;
+
 // Global trees
 BPlusTreeNode* carVinTree = NULL;  // Main car tree by VIN
 BPlusTreeNode** showroomCarTrees = NULL;  // Array of trees, one per showroom
+BPlusTreeNode** showroomSalesPersonTrees = NULL;  // Per-showroom (achieved, node) leaderboards
 BPlusTreeNode* salesPersonTree = NULL;
 BPlusTreeNode* customerTree = NULL;
 BPlusTreeNode* carSalesTree = NULL;  // For tracking sales
+BPlusTreeNode* salesPersonAchievedTree = NULL;  // Secondary index on (achieved, node)
+BPlusTreeNode* loanEmiTree = NULL;  // Secondary index on (emiMonths, car) of loan sales
 
 // Global linked lists for data
 CarNode* carList = NULL;
 SalesPersonNode* salesPersonList = NULL;
 CustomerNode* customerList = NULL;
 
+// Car attribute dictionaries and the sale details of sold cars
+StringDictionary carDictionaries[NUM_CAR_DICTIONARIES];
+DictCode loanPaymentCode = 0;
+CarSale* carSaleSegments[MAX_CAR_SALE_SEGMENTS];  // Sale records never move once written
+size_t numCarSales = 0;
+size_t carSaleCapacity = 0;
+atomic_size_t committedSales;  // Sales that snapshots may see, see Sale snapshots
+
+// Customer purchase histories - one pool shared by all customers
+PurchasePool purchasePool = { NULL, 0, 0 };
+
 // Number of showrooms
 int numShowrooms = 0;
 Showroom* showrooms = NULL;
+ShowroomStats* showroomStats = NULL;  // Parallel to showrooms
+int* showroomSlots = NULL;  // Open addressing on the ID hash, slot in showrooms + 1 (0 = empty)
+size_t numShowroomSlots = 0;  // Always a power of two
+
+// Sales journal - appended on every sale, folded into the data files on compaction
+FILE* journalFile = NULL;
+int journalRecords = 0;
+bool compactionDue = false;  // Atomic - set once journalRecords reaches JOURNAL_COMPACT_THRESHOLD
+off_t journalSize = 0;  // Size at the last flush, for the bytes written counter
+bool journalDisabled = false;  // Set by --bench so its sales leave the data files alone
+
+// Read-only snapshot mapping that loaded records may live in
+void* snapshotMapping = NULL;
+size_t snapshotSize = 0;
+
+// Allocation pools for tree nodes and records
+SlabPool treeNodePool = SLAB_POOL("Tree nodes", BPlusTreeNode);
+SlabPool carNodePool = SLAB_POOL("Cars", CarNode);
+SlabPool salesPersonNodePool = SLAB_POOL("Sales persons", SalesPersonNode);
+SlabPool customerNodePool = SLAB_POOL("Customers", CustomerNode);
+SlabPool loanSalePool = SLAB_POOL("Loan sales", LoanSale);
+SlabPool* const allPools[] = {
+    &treeNodePool, &carNodePool, &salesPersonNodePool, &customerNodePool, &loanSalePool
+};
+
+// Operation latencies and event counters
+LatencyHistogram operationLatencies[NUM_METRIC_TIMERS];
+atomic_uint_fast64_t metricCounters[NUM_METRIC_COUNTERS];
 
 // Function prototypes
+// Slab pools
+void* poolAlloc(SlabPool* pool);
+void poolReset(SlabPool* pool);
+void poolInitLike(SlabPool* pool, const SlabPool* like);
+void poolAdopt(SlabPool* pool, SlabPool* from);
+void printPoolStats(FILE* out);
+
+// Parallel loops
+size_t workerThreadCount();
+void parallelFor(size_t count, ParallelTask task, void* context);
+
+// Metrics
+uint64_t metricsNow();
+void recordLatency(MetricTimer timer, uint64_t startNanos);
+uint64_t metricsSampleStart();
+void metricsAdd(MetricCounter counter, uint64_t amount);
+FILE* openFile(const char* fileName, const char* mode);
+void countFileBytes(FILE* file);
+void printMetrics(FILE* out);
+bool exportMetrics(const char* fileName);
+bool metricsExportDue();
+void metricsTick(bool force);
+
 // B+ Tree operations
+BPlusKey makeStringKey(const char* str);
+BPlusKey makeBytesKey(const char* str, size_t length);
+BPlusKey makeNumericKey(double value, uint64_t tieBreak);
+int compareKeys(BPlusKey a, BPlusKey b);
+bool validKeyLength(const char* str);
 BPlusTreeNode* createNode(bool isLeaf);
+BPlusTreeNode* findLeafByKey(BPlusTreeNode* root, BPlusKey key);
 BPlusTreeNode* findLeaf(BPlusTreeNode* root, const char* key);
+void* searchKey(BPlusTreeNode* root, BPlusKey key);
 void* search(BPlusTreeNode* root, const char* key);
+void insertKeyIntoTree(BPlusTreeNode** rootPtr, BPlusKey key, void* value);
 void insertIntoTree(BPlusTreeNode** rootPtr, const char* key, void* value);
-void splitLeaf(BPlusTreeNode* leaf, BPlusTreeNode** rootPtr);
-void splitNonLeaf(BPlusTreeNode* node, BPlusTreeNode** rootPtr);
-void insertIntoParent(BPlusTreeNode* left, BPlusTreeNode* right, const char* key, BPlusTreeNode** rootPtr);
+bool deleteKeyFromTree(BPlusTreeNode* root, BPlusKey key);
+BPlusTreeNode* splitLeaf(BPlusTreeNode* leaf, BPlusKey* separator);
+BPlusTreeNode* splitNonLeaf(BPlusTreeNode* node, BPlusKey* separator);
+void insertIntoParent(BPlusTreeNode* parent, BPlusTreeNode* left, BPlusTreeNode* right, BPlusKey key);
+void bulkLoadTree(BPlusTreeNode** rootPtr, TreeEntry* entries, size_t count, double fillFactor);
+bool validateTree(const BPlusTreeNode* root, TreeStats* stats);
+
+// Range scans
+void cursorSeek(TreeCursor* cursor, BPlusTreeNode* root, BPlusKey lowKey);
+void cursorSeekFirst(TreeCursor* cursor, BPlusTreeNode* root);
+void cursorSeekRange(TreeCursor* cursor, BPlusTreeNode* root, BPlusKey lowKey, BPlusKey highKey);
+void cursorSeekPrefix(TreeCursor* cursor, BPlusTreeNode* root, const char* prefix);
+bool cursorNext(TreeCursor* cursor, BPlusKey* key, void** value);
+void cursorSeekLast(TreeCursor* cursor, BPlusTreeNode* root);
+bool cursorPrev(TreeCursor* cursor, BPlusKey* key, void** value);
+void sharedCursorSeekRange(SharedTreeCursor* cursor, BPlusTreeNode* const* rootPtr, BPlusKey lowKey, BPlusKey highKey);
+bool sharedCursorNext(SharedTreeCursor* cursor, BPlusKey* key, void** value);
+
+// CSV reader
+bool csvOpen(CsvReader* reader, const char* fileName);
+void csvOpenBuffer(CsvReader* reader, const char* data, size_t size);
+bool csvNextRow(CsvReader* reader);
+void csvClose(CsvReader* reader);
+FieldView csvField(const FieldView* fields, size_t numFields, size_t index);
+bool fieldEquals(FieldView field, const char* str);
+bool validRowKey(FieldView key);
+bool keyFieldFits(FieldView field, const char* what);
+void copyField(char* dest, size_t size, FieldView field);
+int parseFieldInt(FieldView field);
+double parseFieldDouble(FieldView field);
 
 // File operations
+void writeCarRecord(FILE* file, const Car* car);
+void writeSalesPersonRecord(FILE* file, const SalesPerson* salesPerson);
+void writeCustomerRecord(FILE* file, const Customer* customer);
 void saveCarToFile(Car* car);
 void saveSalesPersonToFile(SalesPerson* salesPerson);
 void saveCustomerToFile(Customer* customer);
+bool parseCarRecord(const FieldView* fields, size_t numFields, Car* car, CarSale* sale, StringDictionary* dictionaries);
+bool parseSalesPersonRecord(const FieldView* fields, size_t numFields, SalesPerson* sp);
+bool parseCustomerRecord(const FieldView* fields, size_t numFields, Customer* cust, PurchasePool* pool);
+void importTextFiles();
+bool exportTextFiles();
+bool writeSnapshot(const char* fileName);
+bool loadSnapshot(const char* fileName);
+bool isSnapshotRecord(const void* record);
 void loadDataFromFiles();
 void ensureFilesExist();
 
+// Record insertion shared by loading, journal replay and the add functions
+void indexCarNode(CarNode* node);
+void indexSalesPersonNode(SalesPersonNode* node);
+void indexCustomerNode(CustomerNode* node);
+void indexLoanSale(CarNode* node);
+CarNode* pushCarRecord(const Car* car);
+SalesPersonNode* pushSalesPersonRecord(const SalesPerson* salesPerson);
+CustomerNode* pushCustomerRecord(const Customer* customer);
+CarNode* insertCarRecord(const Car* car);
+SalesPersonNode* insertSalesPersonRecord(const SalesPerson* salesPerson);
+CustomerNode* insertCustomerRecord(const Customer* customer);
+void buildIndexes(const SnapshotIndexes* snapshot);
+
+// Journal operations
+BPlusKey salesPersonAchievedKey(const SalesPersonNode* node);
+bool applySale(CarNode* carNode, CustomerNode* customerNode, SalesPersonNode* salesPersonNode, const char* paymentType, int emiMonths, double downPayment);
+double emiRateForMonths(int emiMonths);
+void appendSaleToJournal(const Car* car);
+void appendSaleBatchToJournal(CarNode* const* cars, size_t count);
+bool parseSaleRequest(const FieldView* fields, size_t numFields, SaleRequest* request);
+void replayJournal();
+void compactDataFiles();
+void compactIfDue();
+void closeJournal();
+
 // Tree initialization
 void initializeTrees();
 
 // Utility functions
 int compareStrings(const char* str1, const char* str2);
 char* createNewId(const char* prefix);
+void copyString(char* dest, size_t size, const char* src);
+
+// Compact car records
+void dictionaryInit(StringDictionary* dictionary);
+void dictionaryFree(StringDictionary* dictionary);
+DictCode dictionaryIntern(StringDictionary* dictionary, const char* value);
+DictCode dictionaryInternBytes(StringDictionary* dictionary, const char* value, size_t length);
+const char* dictionaryString(const StringDictionary* dictionary, DictCode code);
+void initializeCarDictionaries();
+DictCode internCarValue(CarDictionary dictionary, const char* value);
+DictCode internCarField(StringDictionary* dictionaries, CarDictionary dictionary, FieldView field);
+const char* carName(const Car* car);
+const char* carColor(const Car* car);
+const char* carFuelType(const Car* car);
+const char* carBodyType(const Car* car);
+const char* carShowroomId(const Car* car);
+CarSale* carSale(const Car* car);
+CarSale* carSaleAt(size_t index);
+void reserveCarSales(size_t count);
+void addCarSale(Car* car, const CarSale* sale);
+const char* salePaymentType(const CarSale* sale);
+bool boughtOnLoan(const Car* car);
+const Purchase* purchaseAt(uint32_t index);
+void purchasePoolReserve(PurchasePool* pool, size_t count);
+void addPurchase(PurchasePool* pool, Customer* customer, const char* VIN);
+
+// Sale snapshots
+void commitSales();
+void beginSnapshot(SaleSnapshot* snapshot);
+void endSnapshot(SaleSnapshot* snapshot);
+bool carSoldIn(const Car* car, const SaleSnapshot* snapshot);
+double salesPersonAchievedIn(const SalesPersonNode* node, const SaleSnapshot* snapshot);
+void setSalesPersonAchieved(SalesPersonNode* node, double achieved, size_t sequence);
+void freeAchievedHistory(SalesPersonNode* node);
 
 // Data manipulation functions
-void addCar(Car* car);
+void addCar(FILE* out, Car* car);
 void addSalesPerson(SalesPerson* salesPerson);
-void addCustomer(Customer* customer);
+void addCustomer(FILE* out, Customer* customer);
 void sellCar(const char* VIN, const char* customerId, const char* salesPersonId, const char* paymentType, int emiMonths, double downPayment);
 
 // Required functions from problem statement
-void mergeShowrooms(const char* outputFileName);
-void addNewSalesPerson(SalesPerson* salesPerson);
+void mergeShowrooms(FILE* out, const char* outputFileName);
+bool mergeShowroomFiles(const char* const* inputFiles, size_t numInputFiles, const char* outputFileName);
+bool sortMergeFiles(const char* const* inputFiles, size_t numInputFiles, FILE* output, size_t memoryBudget);
+size_t sortMemoryBudget();
+void addNewSalesPerson(FILE* out, SalesPerson* salesPerson);
 char* findMostPopularCar();
+void groupTableInit(GroupCountTable* table, size_t initialCapacity);
+void groupTableAdd(GroupCountTable* table, const char* key, size_t count);
+void groupTableFree(GroupCountTable* table);
+const char* carGroupValue(const Car* car, CarGroupField field);
+const char* carGroupFieldName(CarGroupField field);
+void countCarsBy(CarGroupField field, GroupCountTable* table);
+size_t topGroups(const GroupCountTable* table, GroupCount* out, size_t k);
+void printCarGroupReport(FILE* out, CarGroupField field, size_t k);
 SalesPerson* findMostSuccessfulSalesPerson();
-void sellCarToCustomer(const char* VIN, const char* customerId, const char* salesPersonId, const char* paymentType, int emiMonths, double downPayment);
-void predictNextMonthSales();
-void displayCarInfo(const char* VIN);
-void findSalesPersonByTargetRange(double minSales, double maxSales);
-void listCustomersByEmiRange(int minMonths, int maxMonths);
+double salesPersonIncentive(const SalesPerson* salesPerson);
+size_t topSalesPersons(const char* showroomId, SalesPersonNode** out, size_t n);
+void printSalesLeaderboard(FILE* out, const char* showroomId, size_t n);
+int findShowroomIndex(const char* showroomId);
+SaleStatus validateSale(const SaleRequest* request, CarNode** carNode, CustomerNode** customerNode, SalesPersonNode** salesPersonNode);
+void printSaleError(FILE* out, const SaleRequest* request, SaleStatus status);
+void sellCarToCustomer(FILE* out, const char* VIN, const char* customerId, const char* salesPersonId, const char* paymentType, int emiMonths, double downPayment);
+bool sellCars(const SaleRequest* requests, size_t count, SaleStatus* results);
+void sellCarsFromFile(FILE* out, const char* fileName);
+void predictNextMonthSales(FILE* out);
+void displayCarInfo(FILE* out, const char* VIN);
+void findSalesPersonByTargetRange(FILE* out, double minSales, double maxSales);
+void listCustomersByEmiRange(FILE* out, int minMonths, int maxMonths);
+LoanSale* findLoanSalesByEmiRange(int minMonths, int maxMonths, const SaleSnapshot* snapshot, size_t* count);
+void listCustomerCars(FILE* out, const char* customerId);
+void listCarsByVinPrefix(FILE* out, const char* prefix);
+void listShowroomInventory(FILE* out, const char* showroomId);
+const ShowroomStats* findShowroomStats(const char* showroomId);
+CarNode** findShowroomCars(const char* showroomId, bool available, size_t* count);
+void listShowroomCars(FILE* out, const char* showroomId, bool available);
+void printShowroomDashboard(FILE* out, const char* showroomId);
+void printMostPopularCar(FILE* out);
+void printMostSuccessfulSalesPerson(FILE* out);
 void freeMemory();
 
+// Script mode
+size_t runScript(const char* fileName);
+
+// Server mode
+int runServer(const char* socketPath);
+
+// Data generator and benchmarks
+bool generateDataset(const DatasetSize* size);
+void runBenchmarks(size_t lookups);
+int runTreeBenchmark(size_t numKeys);
+int runTreeStressTest(size_t numThreads, size_t numKeys);
+
 // Implementation of core functions
-BPlusTreeNode* createNode(bool isLeaf) {
-    BPlusTreeNode* newNode = (BPlusTreeNode*)malloc(sizeof(BPlusTreeNode));
-    if (!newNode) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
+// Keys
+// Keys are normalized to KEY_BYTES big-endian bytes, zero padded, so two
+// unsigned 64-bit compares give the same order as strcmp on the original string.
+BPlusKey makeStringKey(const char* str) {
+    return makeBytesKey(str, strnlen(str, KEY_BYTES));
+}
+
+// Key of a string that need not be NUL-terminated
+BPlusKey makeBytesKey(const char* str, size_t length) {
+    unsigned char bytes[KEY_BYTES] = {0};
+    if (length > KEY_BYTES) length = KEY_BYTES;
+    memcpy(bytes, str, length);
+    
+    BPlusKey key = {0, 0};
+    for (int i = 0; i < 8; i++) {
+        key.hi = (key.hi << 8) | bytes[i];
+        key.lo = (key.lo << 8) | bytes[i + 8];
     }
+    return key;
+}
+
+// Numeric keys for secondary indexes: the value in an order-preserving
+// encoding of its IEEE-754 bits, with tieBreak keeping equal values distinct
+BPlusKey makeNumericKey(double value, uint64_t tieBreak) {
+    if (value == 0) value = 0;  // Fold -0.0 into 0.0
     
-    newNode->isLeaf = isLeaf;
-    newNode->numKeys = 0;
-    newNode->next = NULL;
-    newNode->parent = NULL; // Initialize parent to NULL
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & 0x8000000000000000ULL) ? ~bits : bits | 0x8000000000000000ULL;
     
-    // Initialize keys and pointers
-    for (int i = 0; i < B_PLUS_TREE_ORDER - 1; i++) {
-        newNode->keys[i][0] = '\0';
-        if (isLeaf) {
-            newNode->dataPointers[i] = NULL;
-        }
+    BPlusKey key = {bits, tieBreak};
+    return key;
+}
+
+int compareKeys(BPlusKey a, BPlusKey b) {
+    if (a.hi != b.hi) return a.hi < b.hi ? -1 : 1;
+    if (a.lo != b.lo) return a.lo < b.lo ? -1 : 1;
+    return 0;
+}
+
+static inline bool keyEquals(BPlusKey a, BPlusKey b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+// Branch-free a <= b / a < b, so the node scans below compile to straight-line code
+static inline int keyLessOrEqual(BPlusKey a, BPlusKey b) {
+    return (a.hi < b.hi) | ((a.hi == b.hi) & (a.lo <= b.lo));
+}
+
+static inline int keyLess(BPlusKey a, BPlusKey b) {
+    return (a.hi < b.hi) | ((a.hi == b.hi) & (a.lo < b.lo));
+}
+
+// Number of keys in the node that are <= key - the child to descend into
+static inline int nodeUpperBound(const BPlusTreeNode* node, BPlusKey key) {
+    int count = 0;
+    for (int i = 0; i < node->numKeys; i++) {
+        count += keyLessOrEqual(node->keys[i], key);
     }
-    
-    if (!isLeaf) {
-        for (int i = 0; i < B_PLUS_TREE_ORDER; i++) {
-            newNode->children[i] = NULL;
-        }
+    return count;
+}
+
+// Number of keys in the node that are < key - the slot the key belongs in
+static inline int nodeLowerBound(const BPlusTreeNode* node, BPlusKey key) {
+    int count = 0;
+    for (int i = 0; i < node->numKeys; i++) {
+        count += keyLess(node->keys[i], key);
     }
-    
-    return newNode;
+    return count;
 }
 
-BPlusTreeNode* findLeaf(BPlusTreeNode* root, const char* key) {
-    if (!root) return NULL;
+bool validKeyLength(const char* str) {
+    return strlen(str) <= KEY_BYTES;
+}
+
+// Slab pools
+// Objects of one type are bump-allocated from large cache-aligned slabs, so
+// nodes allocated together sit together in memory and a whole pool is released
+// by freeing its slabs. Objects are never returned one at a time.
+static void poolGrow(SlabPool* pool) {
+    size_t alignment = pool->alignment > CACHE_LINE_SIZE ? pool->alignment : CACHE_LINE_SIZE;
+    size_t headerSize = (sizeof(Slab) + pool->alignment - 1) / pool->alignment * pool->alignment;
     
-    BPlusTreeNode* current = root;
-    while (!current->isLeaf) {
-        int i = 0;
-        while (i < current->numKeys && compareStrings(key, current->keys[i]) >= 0) {
-            i++;
-        }
-        current = current->children[i];
+    Slab* slab = NULL;
+    if (posix_memalign((void**)&slab, alignment, SLAB_BYTES) != 0) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->numSlabs++;
     
-    return current;
+    pool->cursor = (char*)slab + headerSize;
+    pool->limit = pool->cursor + (SLAB_BYTES - headerSize) / pool->objectSize * pool->objectSize;
 }
 
-void* search(BPlusTreeNode* root, const char* key) {
-    if (!root) return NULL;
-    
-    BPlusTreeNode* leaf = findLeaf(root, key);
-    if (!leaf) return NULL;
-    
-    for (int i = 0; i < leaf->numKeys; i++) {
-        if (strcmp(leaf->keys[i], key) == 0) {
-            return leaf->dataPointers[i];
-        }
+void* poolAlloc(SlabPool* pool) {
+    pthread_mutex_lock(&pool->lock);
+    if (pool->cursor == pool->limit) {
+        poolGrow(pool);
     }
     
-    return NULL;
+    void* object = pool->cursor;
+    pool->cursor += pool->objectSize;
+    pool->numObjects++;
+    pthread_mutex_unlock(&pool->lock);
+    return object;
 }
 
-void insertIntoParent(BPlusTreeNode* left, BPlusTreeNode* right, const char* key, BPlusTreeNode** rootPtr) {
-    if (!left->parent) {
-        // Create a new root
-        BPlusTreeNode* newRoot = createNode(false);
-        strcpy(newRoot->keys[0], key);
-        newRoot->children[0] = left;
-        newRoot->children[1] = right;
-        newRoot->numKeys = 1;
-        
-        left->parent = newRoot;
-        right->parent = newRoot;
-        
-        *rootPtr = newRoot;
+void poolReset(SlabPool* pool) {
+    Slab* slab = pool->slabs;
+    while (slab) {
+        Slab* next = slab->next;
+        free(slab);
+        slab = next;
+    }
+    pool->slabs = NULL;
+    pool->cursor = NULL;
+    pool->limit = NULL;
+    pool->numSlabs = 0;
+    pool->numObjects = 0;
+}
+
+// Start an empty pool for the same objects as another, such as a private pool
+// a loader thread fills before its slabs are handed over with poolAdopt
+void poolInitLike(SlabPool* pool, const SlabPool* like) {
+    memset(pool, 0, sizeof(*pool));
+    pool->name = like->name;
+    pool->objectSize = like->objectSize;
+    pool->alignment = like->alignment;
+    pthread_mutex_init(&pool->lock, NULL);
+}
+
+// Move every slab of from into pool. The objects keep their addresses and the
+// pool keeps allocating from its own newest slab.
+void poolAdopt(SlabPool* pool, SlabPool* from) {
+    if (!from->slabs) {
         return;
     }
     
-    // Find position to insert in parent
-    BPlusTreeNode* parent = left->parent;
-    int i = 0;
-    while (i < parent->numKeys && parent->children[i] != left) {
-        i++;
+    Slab* last = from->slabs;
+    while (last->next) last = last->next;
+    if (pool->slabs) {
+        last->next = pool->slabs->next;
+        pool->slabs->next = from->slabs;
+    } else {
+        pool->slabs = from->slabs;
+        pool->cursor = from->cursor;
+        pool->limit = from->limit;
     }
+    pool->numSlabs += from->numSlabs;
+    pool->numObjects += from->numObjects;
     
-    // Shift keys and pointers to make room
-    for (int j = parent->numKeys; j > i; j--) {
-        strcpy(parent->keys[j], parent->keys[j-1]);
-        parent->children[j+1] = parent->children[j];
+    from->slabs = NULL;
+    from->cursor = NULL;
+    from->limit = NULL;
+    from->numSlabs = 0;
+    from->numObjects = 0;
+}
+
+void printPoolStats(FILE* out) {
+    fprintf(out, "\n========== Memory Pools ==========\n");
+    for (size_t i = 0; i < sizeof(allPools) / sizeof(allPools[0]); i++) {
+        const SlabPool* pool = allPools[i];
+        fprintf(out, "%-18s %8zu objects x %4zu bytes, %4zu slabs, %10zu bytes reserved, %10zu bytes used\n", 
+                     pool->name, pool->numObjects, pool->objectSize, pool->numSlabs, 
+                     pool->numSlabs * (size_t)SLAB_BYTES, pool->numObjects * pool->objectSize);
     }
-    
-    strcpy(parent->keys[i], key);
-    parent->children[i+1] = right;
-    parent->numKeys++;
-    right->parent = parent;
-    
-    // Check if parent needs splitting
-    if (parent->numKeys == B_PLUS_TREE_ORDER - 1) {
-        splitNonLeaf(parent, rootPtr);
+    fprintf(out, "==================================\n");
+}
+
+// Parallel loops
+// parallelFor runs task(context, i) for every i below count on up to
+// workerThreadCount() threads, the caller included, and returns once all of
+// them are done. Indices are claimed one at a time, so uneven tasks balance.
+size_t workerThreadCount() {
+    long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* requested = getenv(WORKER_THREADS_ENV);
+    if (requested && atoi(requested) > 0) {
+        numThreads = atoi(requested);
     }
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > MAX_WORKER_THREADS) numThreads = MAX_WORKER_THREADS;
+    return (size_t)numThreads;
 }
 
-void splitLeaf(BPlusTreeNode* leaf, BPlusTreeNode** rootPtr) {
-    // Create a new leaf node
-    BPlusTreeNode* newLeaf = createNode(true);
-    int mid = (B_PLUS_TREE_ORDER - 1) / 2;
-    
-    // Move half the keys to the new leaf
-    for (int i = mid; i < B_PLUS_TREE_ORDER - 1; i++) {
-        strcpy(newLeaf->keys[i - mid], leaf->keys[i]);
-        newLeaf->dataPointers[i - mid] = leaf->dataPointers[i];
-        leaf->keys[i][0] = '\0';
-        leaf->dataPointers[i] = NULL;
+static void* parallelWorker(void* arg) {
+    ParallelLoop* loop = (ParallelLoop*)arg;
+    size_t index;
+    while ((index = atomic_fetch_add(&loop->next, 1)) < loop->count) {
+        loop->task(loop->context, index);
     }
+    return NULL;
+}
+
+void parallelFor(size_t count, ParallelTask task, void* context) {
+    ParallelLoop loop;
+    loop.task = task;
+    loop.context = context;
+    loop.count = count;
+    atomic_init(&loop.next, 0);
     
-    newLeaf->numKeys = leaf->numKeys - mid;
-    leaf->numKeys = mid;
-    
-    // Set the next pointers for leaf nodes
-    newLeaf->next = leaf->next;
-    leaf->next = newLeaf;
+    size_t numThreads = workerThreadCount();
+    if (numThreads > count) numThreads = count;
     
-    // Insert into parent
-    char keyUp[MAX_STRING];
-    strcpy(keyUp, newLeaf->keys[0]);
-    insertIntoParent(leaf, newLeaf, keyUp, rootPtr);
+    // A thread that fails to start just leaves its share to the others
+    pthread_t threads[MAX_WORKER_THREADS];
+    size_t started = 0;
+    for (size_t i = 1; i < numThreads; i++) {
+        if (pthread_create(&threads[started], NULL, parallelWorker, &loop) == 0) {
+            started++;
+        }
+    }
+    parallelWorker(&loop);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
 }
 
-void splitNonLeaf(BPlusTreeNode* node, BPlusTreeNode** rootPtr) {
-    // Create a new non-leaf node
-    BPlusTreeNode* newNode = createNode(false);
-    int mid = (B_PLUS_TREE_ORDER - 1) / 2;
+// Metrics
+// Operations record their latency into log2 histograms (bucket i counts
+// durations of 2^i to 2^(i+1) - 1 ns) and events bump counters. Both are
+// relaxed atomics, so recording is a clock read and an uncontended add even
+// from loader threads. Tree shape gauges are measured when metrics are
+// reported. Reports go to stdout on request, and to the Prometheus text file
+// named by SHOWROOM_METRICS_FILE every SHOWROOM_METRICS_INTERVAL seconds.
+static const char* const metricTimerNames[NUM_METRIC_TIMERS] = {
+    "search", "insert", "sell", "sell_batch", "load", "journal_replay", "compact", "merge"
+};
+
+uint64_t metricsNow() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void recordLatency(MetricTimer timer, uint64_t startNanos) {
+    uint64_t nanos = metricsNow() - startNanos;
+    LatencyHistogram* histogram = &operationLatencies[timer];
+    int bucket = 63 - __builtin_clzll(nanos | 1);
+    atomic_fetch_add_explicit(&histogram->buckets[bucket], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sumNanos, nanos, memory_order_relaxed);
+}
+
+// Start time for a call on a hot path, or 0 for calls that are not sampled.
+// Clock reads and atomics cost about as much as a tree search, so only one
+// call in METRIC_SAMPLE_RATE per thread is timed.
+uint64_t metricsSampleStart() {
+    static _Thread_local unsigned countdown = 0;
+    if (countdown > 0) {
+        countdown--;
+        return 0;
+    }
+    countdown = METRIC_SAMPLE_RATE - 1;
+    return metricsNow();
+}
+
+void metricsAdd(MetricCounter counter, uint64_t amount) {
+    atomic_fetch_add_explicit(&metricCounters[counter], amount, memory_order_relaxed);
+}
+
+static uint64_t metricValue(const atomic_uint_fast64_t* value) {
+    return atomic_load_explicit(value, memory_order_relaxed);
+}
+
+FILE* openFile(const char* fileName, const char* mode) {
+    FILE* file = fopen(fileName, mode);
+    if (file) metricsAdd(METRIC_FILES_OPENED, 1);
+    return file;
+}
+
+// Count the size of a file written from the start, once flushed
+void countFileBytes(FILE* file) {
+    struct stat st;
+    if (fflush(file) == 0 && fstat(fileno(file), &st) == 0) {
+        metricsAdd(METRIC_BYTES_WRITTEN, (uint64_t)st.st_size);
+    }
+}
+
+// Upper bound of the histogram bucket holding the given fraction of samples
+static double histogramPercentileNanos(const LatencyHistogram* histogram, double fraction) {
+    uint64_t count = metricValue(&histogram->count);
+    uint64_t rank = (uint64_t)ceil(fraction * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < METRIC_BUCKETS; i++) {
+        seen += metricValue(&histogram->buckets[i]);
+        if (seen >= rank && seen > 0) {
+            return ldexp(1.0, i + 1);
+        }
+    }
+    return 0;
+}
+
+// Index trees whose shape is reported
+static const struct {
+    const char* name;
+    BPlusTreeNode** root;
+} measuredTrees[] = {
+    { "cars", &carVinTree },
+    { "salespersons", &salesPersonTree },
+    { "customers", &customerTree },
+    { "car_sales", &carSalesTree },
+    { "salesperson_achieved", &salesPersonAchievedTree },
+    { "loan_emi", &loanEmiTree },
+};
+#define NUM_MEASURED_TREES (sizeof(measuredTrees) / sizeof(measuredTrees[0]))
+
+static double treeFillRatio(const TreeStats* stats) {
+    return stats->numLeaves > 0 ? (double)stats->numKeys / (stats->numLeaves * (B_PLUS_TREE_ORDER - 1)) : 0.0;
+}
+
+void printMetrics(FILE* out) {
+    fprintf(out, "\n================== Metrics ==================\n");
+    fprintf(out, "%-16s %10s %11s %11s %11s\n", "Operation", "Timed", "Mean (us)", "p50 (us)", "p99 (us)");
+    for (int i = 0; i < NUM_METRIC_TIMERS; i++) {
+        const LatencyHistogram* histogram = &operationLatencies[i];
+        uint64_t count = metricValue(&histogram->count);
+        if (count == 0) continue;
+        fprintf(out, "%-16s %10llu %11.2f %11.2f %11.2f\n", metricTimerNames[i], (unsigned long long)count, 
+                     metricValue(&histogram->sumNanos) / 1000.0 / count, 
+                     histogramPercentileNanos(histogram, 0.50) / 1000.0, 
+                     histogramPercentileNanos(histogram, 0.99) / 1000.0);
+    }
     
-    // Key that will move up to the parent
-    char keyUp[MAX_STRING];
-    strcpy(keyUp, node->keys[mid]);
+    fprintf(out, "(search and insert time one call in %d)\n", METRIC_SAMPLE_RATE);
+    fprintf(out, "\nLeaf splits: %llu\n", (unsigned long long)metricValue(&metricCounters[METRIC_LEAF_SPLITS]));
+    fprintf(out, "Internal node splits: %llu\n", (unsigned long long)metricValue(&metricCounters[METRIC_INTERNAL_SPLITS]));
+    fprintf(out, "Bytes written: %llu\n", (unsigned long long)metricValue(&metricCounters[METRIC_BYTES_WRITTEN]));
+    fprintf(out, "Files opened: %llu\n", (unsigned long long)metricValue(&metricCounters[METRIC_FILES_OPENED]));
     
-    // Move keys and children to the new node
-    for (int i = mid + 1; i < B_PLUS_TREE_ORDER - 1; i++) {
-        strcpy(newNode->keys[i - (mid + 1)], node->keys[i]);
-        node->keys[i][0] = '\0';
+    fprintf(out, "\n%-22s %6s %10s %10s %6s\n", "Tree", "Height", "Nodes", "Keys", "Fill");
+    for (size_t i = 0; i < NUM_MEASURED_TREES; i++) {
+        TreeStats stats;
+        validateTree(*measuredTrees[i].root, &stats);
+        fprintf(out, "%-22s %6zu %10zu %10zu %6.2f\n", measuredTrees[i].name, 
+                     stats.height, stats.numNodes, stats.numKeys, treeFillRatio(&stats));
+    }
+    fprintf(out, "=============================================\n");
+}
+
+// Prometheus text exposition format, replaced atomically through a temporary file
+bool exportMetrics(const char* fileName) {
+    char tempName[MAX_STRING];
+    snprintf(tempName, sizeof(tempName), "%s.tmp", fileName);
+    FILE* file = fopen(tempName, "w");  // Not counted, so exports do not show up in the metrics
+    if (!file) {
+        fprintf(stderr, "Failed to create %s\n", tempName);
+        return false;
     }
     
-    for (int i = mid + 1; i < B_PLUS_TREE_ORDER; i++) {
-        newNode->children[i - (mid + 1)] = node->children[i];
-        if (node->children[i]) {
-            node->children[i]->parent = newNode;
+    fprintf(file, "# HELP showroom_operation_duration_seconds Latency of instrumented operations, search and insert sampled 1 in %d.\n", 
+            METRIC_SAMPLE_RATE);
+    fprintf(file, "# TYPE showroom_operation_duration_seconds histogram\n");
+    for (int i = 0; i < NUM_METRIC_TIMERS; i++) {
+        const LatencyHistogram* histogram = &operationLatencies[i];
+        int lastBucket = -1;
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            if (metricValue(&histogram->buckets[b]) > 0) lastBucket = b;
         }
-        node->children[i] = NULL;
+        uint64_t cumulative = 0;
+        for (int b = 0; b <= lastBucket; b++) {
+            cumulative += metricValue(&histogram->buckets[b]);
+            fprintf(file, "showroom_operation_duration_seconds_bucket{operation=\"%s\",le=\"%.9g\"} %llu\n", 
+                    metricTimerNames[i], ldexp(1.0, b + 1) / 1e9, (unsigned long long)cumulative);
+        }
+        fprintf(file, "showroom_operation_duration_seconds_bucket{operation=\"%s\",le=\"+Inf\"} %llu\n", 
+                metricTimerNames[i], (unsigned long long)metricValue(&histogram->count));
+        fprintf(file, "showroom_operation_duration_seconds_sum{operation=\"%s\"} %.9f\n", 
+                metricTimerNames[i], metricValue(&histogram->sumNanos) / 1e9);
+        fprintf(file, "showroom_operation_duration_seconds_count{operation=\"%s\"} %llu\n", 
+                metricTimerNames[i], (unsigned long long)metricValue(&histogram->count));
     }
     
-    // Update key counts
-    newNode->numKeys = node->numKeys - mid - 1;
-    node->numKeys = mid;
+    fprintf(file, "# HELP showroom_tree_splits_total Node splits by node type.\n");
+    fprintf(file, "# TYPE showroom_tree_splits_total counter\n");
+    fprintf(file, "showroom_tree_splits_total{node=\"leaf\"} %llu\n", 
+            (unsigned long long)metricValue(&metricCounters[METRIC_LEAF_SPLITS]));
+    fprintf(file, "showroom_tree_splits_total{node=\"internal\"} %llu\n", 
+            (unsigned long long)metricValue(&metricCounters[METRIC_INTERNAL_SPLITS]));
+    fprintf(file, "# HELP showroom_written_bytes_total Bytes written to journal, data, snapshot and merge files.\n");
+    fprintf(file, "# TYPE showroom_written_bytes_total counter\n");
+    fprintf(file, "showroom_written_bytes_total %llu\n", 
+            (unsigned long long)metricValue(&metricCounters[METRIC_BYTES_WRITTEN]));
+    fprintf(file, "# HELP showroom_files_opened_total Files opened.\n");
+    fprintf(file, "# TYPE showroom_files_opened_total counter\n");
+    fprintf(file, "showroom_files_opened_total %llu\n", 
+            (unsigned long long)metricValue(&metricCounters[METRIC_FILES_OPENED]));
     
-    // Clear the key that moves up
-    node->keys[mid][0] = '\0';
+    TreeStats stats[NUM_MEASURED_TREES];
+    for (size_t i = 0; i < NUM_MEASURED_TREES; i++) {
+        validateTree(*measuredTrees[i].root, &stats[i]);
+    }
+    fprintf(file, "# HELP showroom_tree_height Levels of each index tree.\n");
+    fprintf(file, "# TYPE showroom_tree_height gauge\n");
+    for (size_t i = 0; i < NUM_MEASURED_TREES; i++) {
+        fprintf(file, "showroom_tree_height{tree=\"%s\"} %zu\n", measuredTrees[i].name, stats[i].height);
+    }
+    fprintf(file, "# HELP showroom_tree_nodes Nodes of each index tree.\n");
+    fprintf(file, "# TYPE showroom_tree_nodes gauge\n");
+    for (size_t i = 0; i < NUM_MEASURED_TREES; i++) {
+        fprintf(file, "showroom_tree_nodes{tree=\"%s\"} %zu\n", measuredTrees[i].name, stats[i].numNodes);
+    }
+    fprintf(file, "# HELP showroom_tree_fill_ratio Keys per leaf slot of each index tree.\n");
+    fprintf(file, "# TYPE showroom_tree_fill_ratio gauge\n");
+    for (size_t i = 0; i < NUM_MEASURED_TREES; i++) {
+        fprintf(file, "showroom_tree_fill_ratio{tree=\"%s\"} %.4f\n", measuredTrees[i].name, treeFillRatio(&stats[i]));
+    }
     
-    // Insert into parent
-    insertIntoParent(node, newNode, keyUp, rootPtr);
+    bool ok = (fflush(file) == 0) && !ferror(file);
+    fclose(file);
+    if (!ok || rename(tempName, fileName) != 0) {
+        fprintf(stderr, "Failed to write %s\n", fileName);
+        remove(tempName);
+        return false;
+    }
+    return true;
 }
 
-void insertIntoTree(BPlusTreeNode** rootPtr, const char* key, void* value) {
-    // If tree is empty, create a new root
-    if (!(*rootPtr)) {
-        *rootPtr = createNode(true);
-        strcpy((*rootPtr)->keys[0], key);
-        (*rootPtr)->dataPointers[0] = value;
-        (*rootPtr)->numKeys = 1;
-        return;
+static uint64_t lastMetricsExport = 0;  // Atomic, so the server can check it without a lock
+
+// Whether an export file is set and the interval has passed since the last export
+bool metricsExportDue() {
+    const char* fileName = getenv(METRICS_FILE_ENV);
+    if (!fileName || !fileName[0]) {
+        return false;
     }
     
-    // Find the leaf node where the key should be inserted
-    BPlusTreeNode* leaf = findLeaf(*rootPtr, key);
-    
-    // Check if key already exists
-    for (int i = 0; i < leaf->numKeys; i++) {
-        if (strcmp(leaf->keys[i], key) == 0) {
-            leaf->dataPointers[i] = value;  // Update value
-            return;
-        }
+    const char* interval = getenv(METRICS_INTERVAL_ENV);
+    uint64_t intervalNanos = (uint64_t)(interval && atoi(interval) > 0 ? atoi(interval) : METRICS_EXPORT_INTERVAL) * 1000000000ULL;
+    uint64_t lastExport = __atomic_load_n(&lastMetricsExport, __ATOMIC_RELAXED);
+    return lastExport == 0 || metricsNow() - lastExport >= intervalNanos;
+}
+
+// Export when it is due. Called between operations, so the trees are never
+// measured while they change.
+void metricsTick(bool force) {
+    const char* fileName = getenv(METRICS_FILE_ENV);
+    if (!fileName || !fileName[0]) {
+        return;
     }
     
-    // Find position to insert
-    int i = leaf->numKeys - 1;
-    while (i >= 0 && compareStrings(key, leaf->keys[i]) < 0) {
-        strcpy(leaf->keys[i + 1], leaf->keys[i]);
-        leaf->dataPointers[i + 1] = leaf->dataPointers[i];
-        i--;
+    uint64_t now = metricsNow();
+    if (force || metricsExportDue()) {
+        exportMetrics(fileName);
+        __atomic_store_n(&lastMetricsExport, now, __ATOMIC_RELAXED);
     }
-    
-    strcpy(leaf->keys[i + 1], key);
-    leaf->dataPointers[i + 1] = value;
-    leaf->numKeys++;
-    
-    // Check if node needs to be split
-    if (leaf->numKeys == B_PLUS_TREE_ORDER - 1) {
-        splitLeaf(leaf, rootPtr);
+}
+
+// Optimistic lock coupling
+// Point lookups, inserts and deletes may run on many threads at once. Readers
+// take no locks: they note a node's version, read it, and trust what they read
+// only if the version is unchanged afterwards. A writer makes the version odd
+// while it changes a node and locks only the nodes it changes. Inserts split
+// full nodes on the way down, so a split never has to climb back up, and the
+// root is split in place, so a tree's root pointer never changes once the tree
+// exists. Nodes are not freed while a tree is in use, so a stale read is
+// always of valid memory. The first root is published only once it holds its
+// key. Bulk loads and cursors are not synchronized and need the tree to
+// themselves, except for shared cursors, see Shared scans. ThreadSanitizer
+// does not follow the version checks and reports the optimistic reads as races.
+static inline unsigned nodeReadBegin(const BPlusTreeNode* node) {
+    unsigned version;
+    while ((version = atomic_load_explicit(&node->version, memory_order_acquire)) & 1) {
+        sched_yield();
     }
+    return version;
 }
 
-// Utility functions
-int compareStrings(const char* str1, const char* str2) {
-    return strcmp(str1, str2);
+static inline bool nodeReadValid(const BPlusTreeNode* node, unsigned version) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&node->version, memory_order_relaxed) == version;
 }
 
-char* createNewId(const char* prefix) {
-    static int counter = 1;
-    char* id = (char*)malloc(MAX_STRING);
-    if (!id) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
+// Lock a node only if it is still as it was when read at version
+static inline bool nodeUpgrade(BPlusTreeNode* node, unsigned version) {
+    if (!atomic_compare_exchange_strong_explicit(&node->version, &version, version + 1, 
+                                                 memory_order_acquire, memory_order_relaxed)) {
+        return false;
     }
-    sprintf(id, "%s%d", prefix, counter++);
-    return id;
+    atomic_thread_fence(memory_order_release);
+    return true;
+}
+
+static inline void nodeUnlock(BPlusTreeNode* node) {
+    atomic_fetch_add_explicit(&node->version, 1, memory_order_release);
+}
+
+BPlusTreeNode* createNode(bool isLeaf) {
+    // Nodes are cache line aligned so a node never straddles more lines than it needs
+    BPlusTreeNode* newNode = (BPlusTreeNode*)poolAlloc(&treeNodePool);
+    
+    // Initialize keys and pointers
+    memset(newNode, 0, sizeof(BPlusTreeNode));
+    atomic_init(&newNode->version, 0);
+    newNode->isLeaf = isLeaf;
+    newNode->numKeys = 0;
+    newNode->next = NULL;
+    newNode->parent = NULL; // Initialize parent to NULL
+    
+    return newNode;
+}
+
+BPlusTreeNode* findLeafByKey(BPlusTreeNode* root, BPlusKey key) {
+    if (!root) return NULL;
+    
+    BPlusTreeNode* current = root;
+    while (!current->isLeaf) {
+        current = current->children[nodeUpperBound(current, key)];
+    }
+    
+    return current;
+}
+
+BPlusTreeNode* findLeaf(BPlusTreeNode* root, const char* key) {
+    return findLeafByKey(root, makeStringKey(key));
+}
+
+// Descend without locking. Returns the leaf for key and its version, or NULL
+// if a writer got in the way and the descent has to start over.
+static BPlusTreeNode* findLeafOptimistic(BPlusTreeNode* root, BPlusKey key, unsigned* version) {
+    BPlusTreeNode* node = root;
+    unsigned nodeVersion = nodeReadBegin(node);
+    while (!node->isLeaf) {
+        BPlusTreeNode* child = node->children[nodeUpperBound(node, key)];
+        if (!nodeReadValid(node, nodeVersion)) {
+            return NULL;
+        }
+        
+        // The parent is checked again so the child cannot have split in between
+        unsigned childVersion = nodeReadBegin(child);
+        if (!nodeReadValid(node, nodeVersion)) {
+            return NULL;
+        }
+        node = child;
+        nodeVersion = childVersion;
+    }
+    *version = nodeVersion;
+    return node;
+}
+
+void* searchKey(BPlusTreeNode* root, BPlusKey key) {
+    uint64_t start = metricsSampleStart();
+    void* value = NULL;
+    
+    while (root) {
+        unsigned version;
+        BPlusTreeNode* leaf = findLeafOptimistic(root, key, &version);
+        if (!leaf) continue;
+        
+        int i = nodeLowerBound(leaf, key);
+        value = (i < leaf->numKeys && keyEquals(leaf->keys[i], key)) ? leaf->dataPointers[i] : NULL;
+        if (nodeReadValid(leaf, version)) break;
+    }
+    
+    if (start) recordLatency(METRIC_SEARCH, start);
+    return value;
+}
+
+void* search(BPlusTreeNode* root, const char* key) {
+    return searchKey(root, makeStringKey(key));
+}
+
+// Add the separator and right half of a split child to its parent, which the
+// caller has locked and which has room for one more key
+void insertIntoParent(BPlusTreeNode* parent, BPlusTreeNode* left, BPlusTreeNode* right, BPlusKey key) {
+    // Find position to insert in parent
+    int i = 0;
+    while (i < parent->numKeys && parent->children[i] != left) {
+        i++;
+    }
+    
+    // Shift keys and pointers to make room
+    memmove(&parent->keys[i + 1], &parent->keys[i], (parent->numKeys - i) * sizeof(BPlusKey));
+    memmove(&parent->children[i + 2], &parent->children[i + 1], (parent->numKeys - i) * sizeof(BPlusTreeNode*));
+    
+    parent->keys[i] = key;
+    parent->children[i+1] = right;
+    parent->numKeys++;
+    right->parent = parent;
+}
+
+// Move the upper half of a full leaf to a new leaf. The new leaf is not yet in
+// the tree; its first key is the separator for the parent.
+BPlusTreeNode* splitLeaf(BPlusTreeNode* leaf, BPlusKey* separator) {
+    metricsAdd(METRIC_LEAF_SPLITS, 1);
+    
+    // Create a new leaf node
+    BPlusTreeNode* newLeaf = createNode(true);
+    int mid = leaf->numKeys / 2;
+    
+    // Move half the keys to the new leaf
+    for (int i = mid; i < leaf->numKeys; i++) {
+        newLeaf->keys[i - mid] = leaf->keys[i];
+        newLeaf->dataPointers[i - mid] = leaf->dataPointers[i];
+        leaf->dataPointers[i] = NULL;
+    }
+    
+    newLeaf->numKeys = leaf->numKeys - mid;
+    leaf->numKeys = mid;
+    
+    // Set the next pointers for leaf nodes
+    newLeaf->next = leaf->next;
+    leaf->next = newLeaf;
+    
+    *separator = newLeaf->keys[0];
+    return newLeaf;
+}
+
+// Move the keys and children above the middle key of a full internal node to
+// a new node; the middle key itself moves up to the parent
+BPlusTreeNode* splitNonLeaf(BPlusTreeNode* node, BPlusKey* separator) {
+    metricsAdd(METRIC_INTERNAL_SPLITS, 1);
+    
+    // Create a new non-leaf node
+    BPlusTreeNode* newNode = createNode(false);
+    int mid = node->numKeys / 2;
+    
+    // Key that will move up to the parent
+    *separator = node->keys[mid];
+    
+    // Move keys and children to the new node
+    for (int i = mid + 1; i < node->numKeys; i++) {
+        newNode->keys[i - (mid + 1)] = node->keys[i];
+    }
+    
+    for (int i = mid + 1; i <= node->numKeys; i++) {
+        newNode->children[i - (mid + 1)] = node->children[i];
+        node->children[i]->parent = newNode;
+        node->children[i] = NULL;
+    }
+    
+    // Update key counts
+    newNode->numKeys = node->numKeys - mid - 1;
+    node->numKeys = mid;
+    
+    return newNode;
+}
+
+static BPlusTreeNode* splitNode(BPlusTreeNode* node, BPlusKey* separator) {
+    return node->isLeaf ? splitLeaf(node, separator) : splitNonLeaf(node, separator);
+}
+
+// Split a full child of a parent with room, both locked by the caller
+static void splitChild(BPlusTreeNode* parent, BPlusTreeNode* child) {
+    BPlusKey separator;
+    BPlusTreeNode* right = splitNode(child, &separator);
+    insertIntoParent(parent, child, right, separator);
+}
+
+// Split a full, locked root in place: its contents move to a new node that is
+// then split, and the root becomes their parent
+static void splitRoot(BPlusTreeNode* root) {
+    BPlusTreeNode* left = createNode(root->isLeaf);
+    memcpy(left->keys, root->keys, sizeof(root->keys));
+    memcpy(left->children, root->children, sizeof(root->children));
+    left->numKeys = root->numKeys;
+    if (!left->isLeaf) {
+        for (int i = 0; i <= left->numKeys; i++) {
+            left->children[i]->parent = left;
+        }
+    }
+    
+    BPlusKey separator;
+    BPlusTreeNode* right = splitNode(left, &separator);
+    
+    memset(root->children, 0, sizeof(root->children));
+    root->keys[0] = separator;
+    root->children[0] = left;
+    root->children[1] = right;
+    root->numKeys = 1;
+    root->isLeaf = false;
+    left->parent = root;
+    right->parent = root;
+}
+
+void insertKeyIntoTree(BPlusTreeNode** rootPtr, BPlusKey key, void* value) {
+    uint64_t start = metricsSampleStart();
+    
+restart:
+    {
+        BPlusTreeNode* node = __atomic_load_n(rootPtr, __ATOMIC_ACQUIRE);
+        
+        // If tree is empty, publish a new root holding the key. Inserts racing
+        // for an empty tree agree on one root; the losers insert into it, and
+        // their unused node stays in the pool, which never returns single nodes.
+        if (!node) {
+            BPlusTreeNode* root = createNode(true);
+            root->keys[0] = key;
+            root->dataPointers[0] = value;
+            root->numKeys = 1;
+            if (!__atomic_compare_exchange_n(rootPtr, &node, root, false, __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+                goto restart;
+            }
+            if (start) recordLatency(METRIC_INSERT, start);
+            return;
+        }
+        
+        BPlusTreeNode* parent = NULL;
+        unsigned parentVersion = 0;
+        unsigned version = nodeReadBegin(node);
+        
+        while (true) {
+            // A full node is split before descending into it, so whatever gets
+            // split below always has a parent with room for the separator
+            if (node->numKeys == B_PLUS_TREE_ORDER - 1) {
+                if (parent && !nodeUpgrade(parent, parentVersion)) goto restart;
+                if (!nodeUpgrade(node, version)) {
+                    if (parent) nodeUnlock(parent);
+                    goto restart;
+                }
+                if (parent) {
+                    splitChild(parent, node);
+                } else {
+                    splitRoot(node);
+                }
+                nodeUnlock(node);
+                if (parent) nodeUnlock(parent);
+                goto restart;
+            }
+            if (node->isLeaf) break;
+            
+            BPlusTreeNode* child = node->children[nodeUpperBound(node, key)];
+            if (!nodeReadValid(node, version)) goto restart;
+            unsigned childVersion = nodeReadBegin(child);
+            if (!nodeReadValid(node, version)) goto restart;
+            
+            parent = node;
+            parentVersion = version;
+            node = child;
+            version = childVersion;
+        }
+        
+        BPlusTreeNode* leaf = node;
+        if (!nodeUpgrade(leaf, version)) goto restart;
+        int i = nodeLowerBound(leaf, key);
+        
+        // Check if key already exists
+        if (i < leaf->numKeys && keyEquals(leaf->keys[i], key)) {
+            leaf->dataPointers[i] = value;  // Update value
+        } else {
+            // Shift the larger keys up one slot
+            memmove(&leaf->keys[i + 1], &leaf->keys[i], (leaf->numKeys - i) * sizeof(BPlusKey));
+            memmove(&leaf->dataPointers[i + 1], &leaf->dataPointers[i], (leaf->numKeys - i) * sizeof(void*));
+            
+            leaf->keys[i] = key;
+            leaf->dataPointers[i] = value;
+            leaf->numKeys++;
+        }
+        nodeUnlock(leaf);
+    }
+    if (start) recordLatency(METRIC_INSERT, start);
+}
+
+void insertIntoTree(BPlusTreeNode** rootPtr, const char* key, void* value) {
+    insertKeyIntoTree(rootPtr, makeStringKey(key), value);
+}
+
+// Removes a key from its leaf without merging underfull nodes. The separators
+// above stay valid bounds, so searches and cursors keep working; space is
+// reclaimed when the tree is rebuilt at the next load.
+bool deleteKeyFromTree(BPlusTreeNode* root, BPlusKey key) {
+    if (!root) return false;
+    
+    BPlusTreeNode* leaf;
+    unsigned version;
+    do {
+        leaf = findLeafOptimistic(root, key, &version);
+    } while (!leaf || !nodeUpgrade(leaf, version));
+    
+    int i = nodeLowerBound(leaf, key);
+    bool found = i < leaf->numKeys && keyEquals(leaf->keys[i], key);
+    if (found) {
+        memmove(&leaf->keys[i], &leaf->keys[i + 1], (leaf->numKeys - i - 1) * sizeof(BPlusKey));
+        memmove(&leaf->dataPointers[i], &leaf->dataPointers[i + 1], (leaf->numKeys - i - 1) * sizeof(void*));
+        leaf->numKeys--;
+        leaf->dataPointers[leaf->numKeys] = NULL;
+    }
+    nodeUnlock(leaf);
+    return found;
+}
+
+// Tree validation
+// Walks the whole tree and checks every invariant the operations rely on: key
+// counts within bounds, keys ascending inside a node and within the range its
+// parent's separators give it, parent pointers, all leaves on one level and the
+// leaf chain visiting the leaves in key order. Reports the first violation.
+static bool treeViolation(const char* problem, const BPlusTreeNode* node) {
+    fprintf(stderr, "Invalid tree: %s (node %p)\n", problem, (const void*)node);
+    return false;
+}
+
+static bool validateSubtree(const BPlusTreeNode* node, const BPlusTreeNode* parent, const BPlusKey* low, const BPlusKey* high, 
+                            size_t depth, TreeStats* stats, const BPlusTreeNode** lastLeaf) {
+    if (node->parent != parent) {
+        return treeViolation("wrong parent pointer", node);
+    }
+    if (node->numKeys > B_PLUS_TREE_ORDER - 1) {
+        return treeViolation("key count out of bounds", node);
+    }
+    if (!node->isLeaf && node->numKeys < 1) {
+        return treeViolation("internal node without keys", node);
+    }
+    for (int i = 0; i < node->numKeys; i++) {
+        if (i > 0 && !keyLess(node->keys[i - 1], node->keys[i])) {
+            return treeViolation("keys out of order", node);
+        }
+        if ((low && keyLess(node->keys[i], *low)) || (high && !keyLess(node->keys[i], *high))) {
+            return treeViolation("key outside its parent's separators", node);
+        }
+    }
+    stats->numNodes++;
+    
+    if (node->isLeaf) {
+        if (stats->height == 0) {
+            stats->height = depth + 1;
+        } else if (stats->height != depth + 1) {
+            return treeViolation("leaves on different levels", node);
+        }
+        if (*lastLeaf && (*lastLeaf)->next != node) {
+            return treeViolation("leaf chain out of order", node);
+        }
+        *lastLeaf = node;
+        stats->numLeaves++;
+        stats->numKeys += node->numKeys;
+        return true;
+    }
+    
+    for (int i = 0; i <= node->numKeys; i++) {
+        if (!node->children[i]) {
+            return treeViolation("missing child", node);
+        }
+        if (!validateSubtree(node->children[i], node, i > 0 ? &node->keys[i - 1] : low, 
+                             i < node->numKeys ? &node->keys[i] : high, depth + 1, stats, lastLeaf)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool validateTree(const BPlusTreeNode* root, TreeStats* stats) {
+    memset(stats, 0, sizeof(TreeStats));
+    if (!root) {
+        return true;
+    }
+    
+    const BPlusTreeNode* lastLeaf = NULL;
+    if (!validateSubtree(root, NULL, NULL, NULL, 0, stats, &lastLeaf)) {
+        return false;
+    }
+    if (lastLeaf->next) {
+        return treeViolation("leaf chain runs past the last leaf", lastLeaf);
+    }
+    return true;
+}
+
+// Range scans
+// A cursor walks the leaf chain from a starting key, optionally stopping after
+// an inclusive end key, so a range query costs one descent plus the leaves it
+// actually returns.
+void cursorSeek(TreeCursor* cursor, BPlusTreeNode* root, BPlusKey lowKey) {
+    cursor->leaf = findLeafByKey(root, lowKey);
+    cursor->position = cursor->leaf ? nodeLowerBound(cursor->leaf, lowKey) : 0;
+    cursor->bounded = false;
+}
+
+void cursorSeekFirst(TreeCursor* cursor, BPlusTreeNode* root) {
+    BPlusTreeNode* current = root;
+    while (current && !current->isLeaf) {
+        current = current->children[0];
+    }
+    cursor->leaf = current;
+    cursor->position = 0;
+    cursor->bounded = false;
+}
+
+void cursorSeekRange(TreeCursor* cursor, BPlusTreeNode* root, BPlusKey lowKey, BPlusKey highKey) {
+    cursorSeek(cursor, root, lowKey);
+    cursor->endKey = highKey;
+    cursor->bounded = true;
+}
+
+// Every key that starts with prefix sorts between the prefix padded with
+// zero bytes and the prefix padded with 0xFF bytes
+void cursorSeekPrefix(TreeCursor* cursor, BPlusTreeNode* root, const char* prefix) {
+    char upper[KEY_BYTES];
+    size_t length = strnlen(prefix, KEY_BYTES);
+    memset(upper, 0xFF, sizeof(upper));
+    memcpy(upper, prefix, length);
+    
+    BPlusKey highKey = {0, 0};
+    for (int i = 0; i < 8; i++) {
+        highKey.hi = (highKey.hi << 8) | (unsigned char)upper[i];
+        highKey.lo = (highKey.lo << 8) | (unsigned char)upper[i + 8];
+    }
+    cursorSeekRange(cursor, root, makeStringKey(prefix), highKey);
+}
+
+bool cursorNext(TreeCursor* cursor, BPlusKey* key, void** value) {
+    // Step over exhausted leaves
+    while (cursor->leaf && cursor->position >= cursor->leaf->numKeys) {
+        cursor->leaf = cursor->leaf->next;
+        cursor->position = 0;
+    }
+    if (!cursor->leaf) {
+        return false;
+    }
+    
+    BPlusKey current = cursor->leaf->keys[cursor->position];
+    if (cursor->bounded && keyLess(cursor->endKey, current)) {
+        cursor->leaf = NULL;
+        return false;
+    }
+    
+    if (key) *key = current;
+    if (value) *value = cursor->leaf->dataPointers[cursor->position];
+    cursor->position++;
+    return true;
+}
+
+// Reverse scans climb the parent pointers to the nearest left sibling subtree
+static BPlusTreeNode* previousLeaf(BPlusTreeNode* leaf) {
+    BPlusTreeNode* child = leaf;
+    BPlusTreeNode* parent = leaf->parent;
+    while (parent) {
+        int i = 0;
+        while (i < parent->numKeys && parent->children[i] != child) {
+            i++;
+        }
+        if (i > 0) {
+            BPlusTreeNode* current = parent->children[i - 1];
+            while (!current->isLeaf) {
+                current = current->children[current->numKeys];
+            }
+            return current;
+        }
+        child = parent;
+        parent = parent->parent;
+    }
+    return NULL;
+}
+
+void cursorSeekLast(TreeCursor* cursor, BPlusTreeNode* root) {
+    BPlusTreeNode* current = root;
+    while (current && !current->isLeaf) {
+        current = current->children[current->numKeys];
+    }
+    cursor->leaf = current;
+    cursor->position = current ? current->numKeys : 0;
+    cursor->bounded = false;
+}
+
+// Steps backwards; the cursor position is the gap after the entry returned
+bool cursorPrev(TreeCursor* cursor, BPlusKey* key, void** value) {
+    while (cursor->leaf && cursor->position == 0) {
+        cursor->leaf = previousLeaf(cursor->leaf);
+        cursor->position = cursor->leaf ? cursor->leaf->numKeys : 0;
+    }
+    if (!cursor->leaf) {
+        return false;
+    }
+    
+    cursor->position--;
+    if (key) *key = cursor->leaf->keys[cursor->position];
+    if (value) *value = cursor->leaf->dataPointers[cursor->position];
+    return true;
+}
+
+// Shared scans
+// A shared cursor walks the leaf chain while other threads insert into the
+// tree. Each entry is read optimistically against the version the leaf had
+// when the cursor stepped onto it; if a writer changed the leaf since, the
+// cursor descends again to the first key after the last one it returned. Keys
+// present for the whole scan are returned once each, in order.
+void sharedCursorSeekRange(SharedTreeCursor* cursor, BPlusTreeNode* const* rootPtr, BPlusKey lowKey, BPlusKey highKey) {
+    cursor->rootPtr = rootPtr;
+    cursor->leaf = NULL;
+    cursor->version = 0;
+    cursor->position = 0;
+    cursor->resumeKey = lowKey;
+    cursor->endKey = highKey;
+    cursor->finished = false;
+}
+
+bool sharedCursorNext(SharedTreeCursor* cursor, BPlusKey* key, void** value) {
+    while (!cursor->finished) {
+        BPlusTreeNode* leaf = cursor->leaf;
+        if (!leaf) {
+            BPlusTreeNode* root = __atomic_load_n(cursor->rootPtr, __ATOMIC_ACQUIRE);
+            if (!root) {
+                cursor->finished = true;
+                break;
+            }
+            leaf = findLeafOptimistic(root, cursor->resumeKey, &cursor->version);
+            if (!leaf) continue;
+            cursor->position = nodeLowerBound(leaf, cursor->resumeKey);
+            if (!nodeReadValid(leaf, cursor->version)) continue;
+            cursor->leaf = leaf;
+        }
+        
+        // Step over an exhausted leaf; the next pointer is only good if the leaf did not change
+        if (cursor->position >= leaf->numKeys) {
+            BPlusTreeNode* next = leaf->next;
+            if (!nodeReadValid(leaf, cursor->version)) {
+                cursor->leaf = NULL;
+                continue;
+            }
+            if (!next) {
+                cursor->finished = true;
+                break;
+            }
+            cursor->version = nodeReadBegin(next);
+            cursor->leaf = next;
+            cursor->position = 0;
+            continue;
+        }
+        
+        BPlusKey current = leaf->keys[cursor->position];
+        void* currentValue = leaf->dataPointers[cursor->position];
+        if (!nodeReadValid(leaf, cursor->version)) {
+            cursor->leaf = NULL;
+            continue;
+        }
+        if (keyLess(cursor->endKey, current)) {
+            cursor->finished = true;
+            break;
+        }
+        
+        cursor->position++;
+        cursor->resumeKey = current;
+        if (++cursor->resumeKey.lo == 0 && ++cursor->resumeKey.hi == 0) {
+            cursor->finished = true;  // That was the largest key there is
+        }
+        if (key) *key = current;
+        if (value) *value = currentValue;
+        return true;
+    }
+    return false;
+}
+
+// Bulk loading
+// Builds a tree bottom-up from a batch of entries instead of inserting them
+// one by one: the entries are sorted (unless they already are), packed into
+// leaves at the requested fill factor and the internal levels are built on
+// top. Nodes may be packed completely full, since inserts split a full node
+// before adding to it.
+static TreeEntry* allocTreeEntries(size_t count) {
+    TreeEntry* entries = (TreeEntry*)malloc((count > 0 ? count : 1) * sizeof(TreeEntry));
+    if (!entries) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return entries;
+}
+
+static int compareTreeEntries(const void* a, const void* b) {
+    const TreeEntry* left = (const TreeEntry*)a;
+    const TreeEntry* right = (const TreeEntry*)b;
+    int cmp = compareKeys(left->key, right->key);
+    if (cmp != 0) return cmp;
+    return (left->seq > right->seq) - (left->seq < right->seq);
+}
+
+// Sort the entries by key unless they already are in ascending or descending order
+static void sortTreeEntries(TreeEntry* entries, size_t count) {
+    bool ascending = true;
+    bool descending = true;
+    for (size_t i = 1; i < count && (ascending || descending); i++) {
+        int cmp = compareTreeEntries(&entries[i - 1], &entries[i]);
+        if (cmp > 0) ascending = false;
+        if (cmp < 0) descending = false;
+    }
+    
+    if (ascending) {
+        return;
+    }
+    if (descending) {
+        for (size_t i = 0, j = count - 1; i < j; i++, j--) {
+            TreeEntry temp = entries[i];
+            entries[i] = entries[j];
+            entries[j] = temp;
+        }
+        return;
+    }
+    qsort(entries, count, sizeof(TreeEntry), compareTreeEntries);
+}
+
+// Number of slots to use per node for a fill factor, between minimum and maximum
+static int bulkLoadSlots(double fillFactor, int minimum, int maximum) {
+    int slots = (int)(fillFactor * maximum + 0.5);
+    if (slots < minimum) slots = minimum;
+    if (slots > maximum) slots = maximum;
+    return slots;
+}
+
+void bulkLoadTree(BPlusTreeNode** rootPtr, TreeEntry* entries, size_t count, double fillFactor) {
+    if (count == 0) {
+        return;
+    }
+    
+    // Bulk loading only builds new trees; merge into an existing one by inserting
+    if (*rootPtr) {
+        for (size_t i = 0; i < count; i++) {
+            insertKeyIntoTree(rootPtr, entries[i].key, entries[i].value);
+        }
+        return;
+    }
+    
+    sortTreeEntries(entries, count);
+    
+    // For duplicate keys the entry with the lowest sequence number wins
+    size_t unique = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (unique > 0 && compareKeys(entries[unique - 1].key, entries[i].key) == 0) {
+            continue;
+        }
+        entries[unique++] = entries[i];
+    }
+    
+    // Leaf level - spread the keys evenly so the last leaf is not left nearly empty
+    const int maxKeys = B_PLUS_TREE_ORDER - 1;
+    size_t perLeaf = bulkLoadSlots(fillFactor, 1, maxKeys);
+    size_t numNodes = (unique + perLeaf - 1) / perLeaf;
+    BPlusTreeNode** level = (BPlusTreeNode**)malloc(numNodes * sizeof(BPlusTreeNode*));
+    BPlusKey* lowKeys = (BPlusKey*)malloc(numNodes * sizeof(BPlusKey));
+    if (!level || !lowKeys) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    size_t next = 0;
+    BPlusTreeNode* previous = NULL;
+    for (size_t n = 0; n < numNodes; n++) {
+        size_t take = (unique - next) / (numNodes - n);
+        if ((unique - next) % (numNodes - n) != 0) take++;
+        
+        BPlusTreeNode* leaf = createNode(true);
+        for (size_t k = 0; k < take; k++, next++) {
+            leaf->keys[k] = entries[next].key;
+            leaf->dataPointers[k] = entries[next].value;
+        }
+        leaf->numKeys = (uint16_t)take;
+        if (previous) previous->next = leaf;
+        previous = leaf;
+        
+        level[n] = leaf;
+        lowKeys[n] = leaf->keys[0];
+    }
+    
+    // Internal levels - every node needs at least two children to carry a key
+    const int maxChildren = B_PLUS_TREE_ORDER;
+    size_t perNode = bulkLoadSlots(fillFactor, 2, maxChildren);
+    while (numNodes > 1) {
+        size_t numParents = (numNodes + perNode - 1) / perNode;
+        if (numParents > 1 && numNodes < 2 * numParents) {
+            numParents = numNodes / 2;
+        }
+        
+        size_t child = 0;
+        for (size_t p = 0; p < numParents; p++) {
+            size_t take = (numNodes - child) / (numParents - p);
+            if ((numNodes - child) % (numParents - p) != 0) take++;
+            
+            BPlusTreeNode* parent = createNode(false);
+            BPlusKey lowKey = lowKeys[child];
+            for (size_t c = 0; c < take; c++, child++) {
+                parent->children[c] = level[child];
+                level[child]->parent = parent;
+                if (c > 0) {
+                    parent->keys[c - 1] = lowKeys[child];
+                }
+            }
+            parent->numKeys = (uint16_t)(take - 1);
+            
+            // Parents are written in place over the level they were built from
+            level[p] = parent;
+            lowKeys[p] = lowKey;
+        }
+        numNodes = numParents;
+    }
+    
+    *rootPtr = level[0];
+    free(level);
+    free(lowKeys);
+}
+
+// Utility functions
+static uint64_t hashBytes(const char* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;  // FNV-1a
+    for (size_t i = 0; i < length; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t hashString(const char* str) {
+    return hashBytes(str, strlen(str));
+}
+
+int compareStrings(const char* str1, const char* str2) {
+    return strcmp(str1, str2);
+}
+
+char* createNewId(const char* prefix) {
+    static int counter = 1;
+    char* id = (char*)malloc(MAX_STRING);
+    if (!id) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(id, "%s%d", prefix, counter++);
+    return id;
+}
+
+// Copy into a fixed-width field, truncating if needed
+void copyString(char* dest, size_t size, const char* src) {
+    size_t length = strlen(src);
+    if (length >= size) length = size - 1;
+    memcpy(dest, src, length);
+    dest[length] = '\0';
 }
 
 // Ensure all required files exist
 void ensureFilesExist() {
     FILE* file;
     
-    // Check car data file
-    file = fopen(CAR_DATA_FILE, "r");
-    if (!file) {
-        file = fopen(CAR_DATA_FILE, "w");
-        if (!file) {
-            fprintf(stderr, "Failed to create car data file\n");
+    // Check car data file
+    file = openFile(CAR_DATA_FILE, "r");
+    if (!file) {
+        file = openFile(CAR_DATA_FILE, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create car data file\n");
+            exit(1);
+        }
+    }
+    fclose(file);
+    
+    // Check salesperson data file
+    file = openFile(SALESPERSON_DATA_FILE, "r");
+    if (!file) {
+        file = openFile(SALESPERSON_DATA_FILE, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create salesperson data file\n");
+            exit(1);
+        }
+    }
+    fclose(file);
+    
+    // Check customer data file
+    file = openFile(CUSTOMER_DATA_FILE, "r");
+    if (!file) {
+        file = openFile(CUSTOMER_DATA_FILE, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create customer data file\n");
+            exit(1);
+        }
+    }
+    fclose(file);
+    
+    // Check sales data file
+    file = openFile(SALES_DATA_FILE, "r");
+    if (!file) {
+        file = openFile(SALES_DATA_FILE, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create sales data file\n");
+            exit(1);
+        }
+    }
+    fclose(file);
+    
+    // Check showroom data file
+    file = openFile(SHOWROOM_DATA_FILE, "r");
+    if (!file) {
+        file = openFile(SHOWROOM_DATA_FILE, "w");
+        if (!file) {
+            fprintf(stderr, "Failed to create showroom data file\n");
+            exit(1);
+        }
+        
+        // Create a default showroom if file was just created
+        fprintf(file, "SHW1,Main Showroom,Default\n");
+    }
+    fclose(file);
+}
+
+// File operations
+// Record writers shared by the append paths and compaction
+void writeCarRecord(FILE* file, const Car* car) {
+    fprintf(file, "%s,%s,%s,%.2f,%s,%s,%s,%d", 
+            car->VIN, carName(car), carColor(car), car->price, 
+            carFuelType(car), carBodyType(car), carShowroomId(car), car->available);
+    
+    const CarSale* sale = carSale(car);
+    if (!car->available && sale) {
+        fprintf(file, ",%s,%s,%s", sale->customerId, sale->salesPersonId, salePaymentType(sale));
+        if (sale->paymentType == loanPaymentCode) {
+            fprintf(file, ",%d,%.2f,%.2f", sale->emiMonths, sale->downPayment, sale->emiRate);
+        }
+    }
+    
+    fprintf(file, "\n");
+}
+
+void writeSalesPersonRecord(FILE* file, const SalesPerson* salesPerson) {
+    fprintf(file, "%s,%s,%s,%.2f,%.2f,%.2f\n", 
+            salesPerson->id, salesPerson->name, salesPerson->showroomId, 
+            salesPerson->target, salesPerson->achieved, salesPerson->commission);
+}
+
+void writeCustomerRecord(FILE* file, const Customer* customer) {
+    fprintf(file, "%s,%s,%s,%s", 
+            customer->id, customer->name, customer->mobileNo, customer->address);
+    
+    if (customer->numPurchasedCars > 0) {
+        fprintf(file, ",%u", customer->numPurchasedCars);
+        for (const Purchase* purchase = purchaseAt(customer->firstPurchase); purchase; purchase = purchaseAt(purchase->next)) {
+            fprintf(file, ",%s", purchase->VIN);
+        }
+    }
+    
+    fprintf(file, "\n");
+}
+
+// Achieved index key - a hash of the ID keeps salespeople with equal sales
+// apart, in an order that does not depend on where the records were loaded
+BPlusKey salesPersonAchievedKey(const SalesPersonNode* node) {
+    return makeNumericKey(node->salesPerson.achieved, hashString(node->salesPerson.id));
+}
+
+// Journal operations
+// Every change is persisted as one record appended to the journal: CAR,
+// CUSTOMER and SALESPERSON carry a full data file line for an added record and
+// SALE carries the arguments of a sale. The journal is replayed on top of the
+// snapshot (or the text files) at startup and folded into them by compaction.
+// Yearly interest rate of a loan, set by its length
+double emiRateForMonths(int emiMonths) {
+    if (emiMonths <= 36) {
+        return 8.50;
+    } else if (emiMonths <= 60) {
+        return 8.75;
+    }
+    return 9.00;
+}
+
+bool applySale(CarNode* carNode, CustomerNode* customerNode, SalesPersonNode* salesPersonNode, const char* paymentType, int emiMonths, double downPayment) {
+    if (!carNode->car.available) {
+        return false;
+    }
+    
+    // Update car data
+    CarSale sale;
+    memset(&sale, 0, sizeof(sale));
+    copyString(sale.customerId, sizeof(sale.customerId), customerNode->customer.id);
+    copyString(sale.salesPersonId, sizeof(sale.salesPersonId), salesPersonNode->salesPerson.id);
+    sale.paymentType = internCarValue(DICT_PAYMENT_TYPE, paymentType);
+    if (sale.paymentType == loanPaymentCode) {
+        sale.emiMonths = emiMonths;
+        sale.downPayment = downPayment;
+        sale.emiRate = emiRateForMonths(emiMonths);
+    }
+    carNode->car.available = false;
+    addCarSale(&carNode->car, &sale);
+    indexLoanSale(carNode);
+    
+    int carShowroomIndex = findShowroomIndex(carShowroomId(&carNode->car));
+    if (carShowroomIndex >= 0) {
+        showroomStats[carShowroomIndex].numSold++;
+        showroomStats[carShowroomIndex].soldValue += carNode->car.price;
+    }
+    
+    // Update customer data
+    addPurchase(&purchasePool, &customerNode->customer, carNode->car.VIN);
+    
+    // Update sales person data, moving them to their new place in the achieved index
+    double carPriceInLakhs = carNode->car.price / 100000.0;  // Convert to lakhs
+    int showroomIndex = findShowroomIndex(salesPersonNode->salesPerson.showroomId);
+    BPlusKey oldKey = salesPersonAchievedKey(salesPersonNode);
+    deleteKeyFromTree(salesPersonAchievedTree, oldKey);
+    if (showroomIndex >= 0) deleteKeyFromTree(showroomSalesPersonTrees[showroomIndex], oldKey);
+    
+    setSalesPersonAchieved(salesPersonNode, salesPersonNode->salesPerson.achieved + carPriceInLakhs, 
+                           carNode->car.saleIndex);
+    salesPersonNode->salesPerson.commission = salesPersonNode->salesPerson.achieved * COMMISSION_RATE;
+    
+    BPlusKey newKey = salesPersonAchievedKey(salesPersonNode);
+    insertKeyIntoTree(&salesPersonAchievedTree, newKey, salesPersonNode);
+    if (showroomIndex >= 0) insertKeyIntoTree(&showroomSalesPersonTrees[showroomIndex], newKey, salesPersonNode);
+    
+    return true;
+}
+
+static FILE* openJournal() {
+    if (journalDisabled) return NULL;
+    if (!journalFile) {
+        journalFile = openFile(JOURNAL_FILE, "a");
+        struct stat st;
+        if (!journalFile) {
+            fprintf(stderr, "Failed to open journal file\n");
+        } else if (fstat(fileno(journalFile), &st) == 0) {
+            journalSize = st.st_size;
+        }
+    }
+    return journalFile;
+}
+
+static void finishJournalRecords(int count) {
+    fflush(journalFile);
+    journalRecords += count;
+    
+    struct stat st;
+    if (fstat(fileno(journalFile), &st) == 0 && st.st_size > journalSize) {
+        metricsAdd(METRIC_BYTES_WRITTEN, (uint64_t)(st.st_size - journalSize));
+        journalSize = st.st_size;
+    }
+    
+    // Keep replay time bounded by folding the journal into the data files -
+    // later, so the sale or add that crossed the threshold does not pay for it
+    if (journalRecords >= JOURNAL_COMPACT_THRESHOLD) {
+        __atomic_store_n(&compactionDue, true, __ATOMIC_RELAXED);
+    }
+}
+
+static void writeSaleRecord(FILE* file, const Car* car) {
+    const CarSale* sale = carSale(car);
+    if (!sale) return;
+    
+    fprintf(file, "SALE,%s,%s,%s,%s,%d,%.2f\n", 
+            car->VIN, sale->customerId, sale->salesPersonId, salePaymentType(sale), 
+            sale->emiMonths, sale->downPayment);
+}
+
+void appendSaleToJournal(const Car* car) {
+    FILE* file = openJournal();
+    if (!file) return;
+    
+    writeSaleRecord(file, car);
+    finishJournalRecords(1);
+}
+
+// The sales of a batch between BEGIN and COMMIT, written with a single flush
+void appendSaleBatchToJournal(CarNode* const* cars, size_t count) {
+    FILE* file = openJournal();
+    if (!file) return;
+    
+    fprintf(file, "BEGIN,%zu\n", count);
+    for (size_t i = 0; i < count; i++) {
+        writeSaleRecord(file, &cars[i]->car);
+    }
+    fprintf(file, "COMMIT\n");
+    finishJournalRecords((int)count);
+}
+
+void saveCarToFile(Car* car) {
+    FILE* file = openJournal();
+    if (!file) return;
+    
+    fprintf(file, "CAR,");
+    writeCarRecord(file, car);
+    finishJournalRecords(1);
+}
+
+void saveSalesPersonToFile(SalesPerson* salesPerson) {
+    FILE* file = openJournal();
+    if (!file) return;
+    
+    fprintf(file, "SALESPERSON,");
+    writeSalesPersonRecord(file, salesPerson);
+    finishJournalRecords(1);
+}
+
+void saveCustomerToFile(Customer* customer) {
+    FILE* file = openJournal();
+    if (!file) return;
+    
+    fprintf(file, "CUSTOMER,");
+    writeCustomerRecord(file, customer);
+    finishJournalRecords(1);
+}
+
+static void replaySale(const SaleRequest* request) {
+    CarNode* carNode = (CarNode*)search(carVinTree, request->VIN);
+    CustomerNode* customerNode = (CustomerNode*)search(customerTree, request->customerId);
+    SalesPersonNode* salesPersonNode = (SalesPersonNode*)search(salesPersonTree, request->salesPersonId);
+    if (!carNode || !customerNode || !salesPersonNode) {
+        fprintf(stderr, "Skipping journal record for unknown VIN %s\n", request->VIN);
+        return;
+    }
+    
+    // Cars already sold in the data files were compacted before the journal was truncated
+    applySale(carNode, customerNode, salesPersonNode, request->paymentType, 
+              request->emiMonths, request->downPayment);
+    commitSales();
+}
+
+void replayJournal() {
+    uint64_t start = metricsNow();
+    CsvReader reader;
+    if (!csvOpen(&reader, JOURNAL_FILE)) {
+        return;
+    }
+    
+    // Sales of a batch are held back until its COMMIT is seen
+    SaleRequest* batch = NULL;
+    size_t batchCount = 0;
+    size_t batchCapacity = 0;
+    bool inBatch = false;
+    size_t batchStart = 0;
+    
+    journalRecords = 0;
+    for (size_t rowStart = reader.position; csvNextRow(&reader); rowStart = reader.position) {
+        FieldView tag = reader.fields[0];
+        const FieldView* fields = reader.fields + 1;
+        size_t numFields = reader.numFields - 1;
+        
+        // Added records are skipped when compaction already wrote them out
+        if (fieldEquals(tag, "CAR")) {
+            Car car;
+            CarSale sale;
+            if (parseCarRecord(fields, numFields, &car, &sale, carDictionaries) && !search(carVinTree, car.VIN)) {
+                if (!car.available) addCarSale(&car, &sale);
+                insertCarRecord(&car);
+            }
+            journalRecords++;
+            continue;
+        }
+        if (fieldEquals(tag, "SALESPERSON")) {
+            SalesPerson sp;
+            if (parseSalesPersonRecord(fields, numFields, &sp) && !search(salesPersonTree, sp.id)) {
+                insertSalesPersonRecord(&sp);
+            }
+            journalRecords++;
+            continue;
+        }
+        if (fieldEquals(tag, "CUSTOMER")) {
+            Customer cust;
+            if (parseCustomerRecord(fields, numFields, &cust, &purchasePool) && !search(customerTree, cust.id)) {
+                insertCustomerRecord(&cust);
+            }
+            journalRecords++;
+            continue;
+        }
+        if (fieldEquals(tag, "BEGIN")) {
+            inBatch = true;
+            batchStart = rowStart;
+            batchCount = 0;
+            continue;
+        }
+        if (fieldEquals(tag, "COMMIT")) {
+            if (inBatch) {
+                for (size_t i = 0; i < batchCount; i++) {
+                    replaySale(&batch[i]);
+                }
+                journalRecords += (int)batchCount;
+            }
+            inBatch = false;
+            continue;
+        }
+        if (!fieldEquals(tag, "SALE")) {
+            continue;
+        }
+        
+        SaleRequest request;
+        if (!parseSaleRequest(fields, numFields, &request)) {
+            continue;  // Torn record from an interrupted write
+        }
+        if (inBatch) {
+            if (batchCount == batchCapacity) {
+                batchCapacity = batchCapacity ? batchCapacity * 2 : 64;
+                SaleRequest* grown = (SaleRequest*)realloc(batch, batchCapacity * sizeof(SaleRequest));
+                if (!grown) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+                batch = grown;
+            }
+            batch[batchCount++] = request;
+            continue;
+        }
+        journalRecords++;
+        replaySale(&request);
+    }
+    csvClose(&reader);
+    free(batch);
+    
+    // A batch without its COMMIT never happened - cut it off so later records
+    // are not taken for part of it
+    if (inBatch) {
+        fprintf(stderr, "Discarding an incomplete sale batch from the journal\n");
+        if (truncate(JOURNAL_FILE, (off_t)batchStart) != 0) {
+            fprintf(stderr, "Failed to truncate journal file\n");
+        }
+    }
+    commitSales();
+    recordLatency(METRIC_JOURNAL_REPLAY, start);
+}
+
+// Rewrite a data file through a temporary file so a crash never leaves it half
+// written. The temporary name is unique, so two writers of the same file (like
+// concurrent merges) never truncate each other's output.
+static FILE* openCompactionFile(const char* fileName, char* tempName, size_t tempSize) {
+    snprintf(tempName, tempSize, "%s.XXXXXX", fileName);
+    int fd = mkstemp(tempName);
+    if (fd >= 0) {
+        metricsAdd(METRIC_FILES_OPENED, 1);
+        fchmod(fd, 0644);  // mkstemp makes it private, unlike the file it replaces
+    }
+    FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(tempName);
+        }
+        fprintf(stderr, "Failed to create a temporary file for %s\n", fileName);
+    }
+    return file;
+}
+
+static bool finishCompactionFile(FILE* file, const char* tempName, const char* fileName) {
+    bool ok = (fflush(file) == 0) && !ferror(file);
+    countFileBytes(file);
+    fclose(file);
+    if (!ok || rename(tempName, fileName) != 0) {
+        fprintf(stderr, "Failed to write %s\n", fileName);
+        remove(tempName);
+        return false;
+    }
+    return true;
+}
+
+void compactDataFiles() {
+    uint64_t start = metricsNow();
+    
+    // The snapshot is written last so it is newer than the text export
+    if (!exportTextFiles() || !writeSnapshot(SNAPSHOT_FILE)) {
+        return;  // Keep the journal so nothing is lost
+    }
+    
+    // Every journaled change is now in the data files, so the journal can start over
+    closeJournal();
+    FILE* file = openFile(JOURNAL_FILE, "w");
+    if (file) {
+        fclose(file);
+    }
+    journalRecords = 0;
+    recordLatency(METRIC_COMPACT, start);
+}
+
+// Compact if the journal has reached its threshold. Called between operations
+// with sales and adds shut out, so only reads may run alongside.
+void compactIfDue() {
+    if (__atomic_exchange_n(&compactionDue, false, __ATOMIC_RELAXED) && 
+        journalRecords >= JOURNAL_COMPACT_THRESHOLD) {
+        compactDataFiles();
+    }
+}
+
+void closeJournal() {
+    if (journalFile) {
+        fclose(journalFile);
+        journalFile = NULL;
+    }
+}
+
+// Showroom feed merge
+// Feeds are mapped and cut into runs of at most a share of the memory budget.
+// Runs are checked, and sorted and spilled to a temporary file only when out of
+// order, on all cores at once. The runs are then merged through a min-heap
+// keyed on the VIN of every run's current line, so each record costs O(log k)
+// comparisons for k runs, and whole lines are copied to the output untouched.
+// Equal VINs come out in input order.
+static bool mergeSourceNext(MergeSource* source) {
+    CsvReader* reader = &source->reader;
+    while (reader->position < reader->size) {
+        const char* line = reader->data + reader->position;
+        size_t remaining = reader->size - reader->position;
+        const char* newline = (const char*)memchr(line, '\n', remaining);
+        size_t length = newline ? (size_t)(newline - line) : remaining;
+        reader->position += newline ? length + 1 : length;
+        
+        source->newlineFollows = newline != NULL;
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+            source->newlineFollows = false;
+        }
+        if (length == 0) {
+            continue;  // Blank lines carry no record
+        }
+        const char* comma = (const char*)memchr(line, ',', length);
+        source->line = line;
+        source->length = length;
+        source->keyLength = comma ? (size_t)(comma - line) : length;
+        source->key = makeBytesKey(line, source->keyLength);
+        
+        // A feed is read again only after the other feeds have had a turn, by
+        // which time its data is out of cache, so start fetching it now
+        for (int i = 1; i <= MERGE_PREFETCH_LINES; i++) {
+            __builtin_prefetch(reader->data + reader->position + i * CACHE_LINE_SIZE);
+        }
+        return true;
+    }
+    return false;
+}
+
+// Byte order on the VIN, like compareStrings. The normalized keys settle almost
+// every comparison; only VINs longer than a key need memcmp.
+static int compareLineKeys(BPlusKey aKey, const char* a, size_t aLength, BPlusKey bKey, const char* b, size_t bLength) {
+    if (!keyEquals(aKey, bKey)) {
+        return keyLess(aKey, bKey) ? -1 : 1;
+    }
+    if (aLength > KEY_BYTES || bLength > KEY_BYTES) {
+        size_t length = aLength < bLength ? aLength : bLength;
+        int order = memcmp(a, b, length);
+        if (order != 0) return order;
+        if (aLength != bLength) return aLength < bLength ? -1 : 1;
+    }
+    return 0;
+}
+
+static bool mergeSourceLess(const MergeSource* a, const MergeSource* b) {
+    int order = compareLineKeys(a->key, a->line, a->keyLength, b->key, b->line, b->keyLength);
+    return order != 0 ? order < 0 : a->index < b->index;
+}
+
+static void mergeHeapSiftDown(MergeSource** heap, size_t count, size_t i) {
+    MergeSource* item = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= count) break;
+        if (child + 1 < count && mergeSourceLess(heap[child + 1], heap[child])) child++;
+        if (!mergeSourceLess(heap[child], item)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = item;
+}
+
+// Merge sources whose readers are open on sorted lines, in index order
+static bool mergeSources(MergeSource* sources, size_t numSources, FILE* output) {
+    MergeSource** heap = (MergeSource**)malloc((numSources > 0 ? numSources : 1) * sizeof(MergeSource*));
+    if (!heap) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    size_t count = 0;
+    for (size_t i = 0; i < numSources; i++) {
+        sources[i].index = i;
+        if (mergeSourceNext(&sources[i])) {
+            heap[count++] = &sources[i];
+        }
+    }
+    for (size_t i = count / 2; i-- > 0;) {
+        mergeHeapSiftDown(heap, count, i);
+    }
+    
+    while (count > 0) {
+        MergeSource* top = heap[0];
+        if (top->newlineFollows) {
+            fwrite(top->line, 1, top->length + 1, output);
+        } else {
+            fwrite(top->line, 1, top->length, output);
+            fputc('\n', output);
+        }
+        if (!mergeSourceNext(top)) {
+            heap[0] = heap[--count];
+        }
+        if (count > 0) {
+            mergeHeapSiftDown(heap, count, 0);
+        }
+    }
+    
+    free(heap);
+    return !ferror(output);
+}
+
+// Memory for the external sort - SHOWROOM_SORT_MB overrides the default
+size_t sortMemoryBudget() {
+    const char* requested = getenv(SORT_MEMORY_ENV);
+    if (requested && atol(requested) > 0) {
+        return (size_t)atol(requested) * 1024 * 1024;
+    }
+    return SORT_MEMORY_BUDGET;
+}
+
+static int compareSortLines(const void* a, const void* b) {
+    const SortLine* lineA = (const SortLine*)a;
+    const SortLine* lineB = (const SortLine*)b;
+    int order = compareLineKeys(lineA->key, lineA->line, lineA->keyLength, lineB->key, lineB->line, lineB->keyLength);
+    if (order != 0) return order;
+    return lineA->line < lineB->line ? -1 : (lineA->line > lineB->line);  // Keep file order
+}
+
+// Sort one run into a temporary file, unless its lines are in order already
+static void sortRunTask(void* context, size_t index) {
+    SortRun* run = &((SortRun*)context)[index];
+    MergeSource source;
+    memset(&source, 0, sizeof(source));
+    csvOpenBuffer(&source.reader, run->data, run->size);
+    
+    size_t numLines = 0;
+    bool sorted = true;
+    BPlusKey previousKey = {0, 0};
+    const char* previousLine = NULL;
+    size_t previousKeyLength = 0;
+    while (mergeSourceNext(&source)) {
+        if (previousLine && sorted &&
+            compareLineKeys(previousKey, previousLine, previousKeyLength, source.key, source.line, source.keyLength) > 0) {
+            sorted = false;
+        }
+        previousKey = source.key;
+        previousLine = source.line;
+        previousKeyLength = source.keyLength;
+        numLines++;
+    }
+    if (sorted) {
+        return;  // Merged straight from the input mapping
+    }
+    
+    SortLine* lines = (SortLine*)malloc(numLines * sizeof(SortLine));
+    if (!lines) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    csvOpenBuffer(&source.reader, run->data, run->size);
+    for (size_t i = 0; mergeSourceNext(&source); i++) {
+        lines[i].key = source.key;
+        lines[i].line = source.line;
+        lines[i].length = (uint32_t)source.length;
+        lines[i].keyLength = (uint32_t)source.keyLength;
+    }
+    qsort(lines, numLines, sizeof(SortLine), compareSortLines);
+    
+    copyString(run->fileName, sizeof(run->fileName), SORT_RUN_TEMPLATE);
+    int fd = mkstemp(run->fileName);
+    if (fd >= 0) metricsAdd(METRIC_FILES_OPENED, 1);
+    FILE* file = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!file) {
+        if (fd >= 0) {
+            close(fd);
+            unlink(run->fileName);
+        }
+        run->failed = true;
+        free(lines);
+        return;
+    }
+    run->spilled = true;
+    setvbuf(file, NULL, _IOFBF, MERGE_OUTPUT_BUFFER);
+    for (size_t i = 0; i < numLines; i++) {
+        fwrite(lines[i].line, 1, lines[i].length, file);
+        fputc('\n', file);
+    }
+    countFileBytes(file);
+    if (fclose(file) != 0) {
+        run->failed = true;
+    }
+    free(lines);
+}
+
+// Cut a mapped input into runs of runBytes, each extended to the end of a line
+static void splitSortRuns(SortRun** runs, size_t* numRuns, size_t* capacity, const char* data, size_t size, size_t runBytes) {
+    size_t start = 0;
+    while (start < size) {
+        size_t end = size;
+        if (size - start > runBytes) {
+            const char* newline = (const char*)memchr(data + start + runBytes, '\n', size - start - runBytes);
+            end = newline ? (size_t)(newline - data) + 1 : size;
+        }
+        
+        if (*numRuns == *capacity) {
+            size_t grown = *capacity ? *capacity * 2 : 16;
+            SortRun* resized = (SortRun*)realloc(*runs, grown * sizeof(SortRun));
+            if (!resized) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            *runs = resized;
+            *capacity = grown;
+        }
+        SortRun* run = &(*runs)[(*numRuns)++];
+        memset(run, 0, sizeof(*run));
+        run->data = data + start;
+        run->size = end - start;
+        start = end;
+    }
+}
+
+// External merge sort of the lines of every input by their first field. Each
+// in-flight run holds its slice of input and a SortLine per line, so runs get
+// half of a thread's share of memoryBudget.
+bool sortMergeFiles(const char* const* inputFiles, size_t numInputFiles, FILE* output, size_t memoryBudget) {
+    size_t runBytes = memoryBudget / (2 * workerThreadCount());
+    if (runBytes < SORT_MIN_RUN_BYTES) runBytes = SORT_MIN_RUN_BYTES;
+    
+    CsvReader* inputs = (CsvReader*)calloc(numInputFiles > 0 ? numInputFiles : 1, sizeof(CsvReader));
+    if (!inputs) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    bool success = true;
+    size_t opened = 0;
+    SortRun* runs = NULL;
+    size_t numRuns = 0;
+    size_t runCapacity = 0;
+    for (size_t i = 0; i < numInputFiles; i++) {
+        if (!csvOpen(&inputs[i], inputFiles[i])) {
+            fprintf(stderr, "Failed to open input file: %s\n", inputFiles[i]);
+            success = false;
+            break;
+        }
+        opened++;
+        splitSortRuns(&runs, &numRuns, &runCapacity, inputs[i].data, inputs[i].size, runBytes);
+    }
+    
+    if (success) {
+        parallelFor(numRuns, sortRunTask, runs);
+        for (size_t i = 0; i < numRuns; i++) {
+            if (runs[i].failed) {
+                fprintf(stderr, "Failed to write sort run\n");
+                success = false;
+                break;
+            }
+        }
+    }
+    
+    if (success) {
+        MergeSource* sources = (MergeSource*)calloc(numRuns > 0 ? numRuns : 1, sizeof(MergeSource));
+        if (!sources) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        size_t numSources = 0;
+        for (size_t i = 0; i < numRuns && success; i++) {
+            if (!runs[i].spilled) {
+                csvOpenBuffer(&sources[numSources++].reader, runs[i].data, runs[i].size);
+            } else if (csvOpen(&sources[numSources].reader, runs[i].fileName)) {
+                numSources++;
+            } else {
+                fprintf(stderr, "Failed to open sort run: %s\n", runs[i].fileName);
+                success = false;
+            }
+        }
+        if (success) {
+            success = mergeSources(sources, numSources, output);
+        }
+        for (size_t i = 0; i < numSources; i++) {
+            csvClose(&sources[i].reader);
+        }
+        free(sources);
+    }
+    
+    for (size_t i = 0; i < numRuns; i++) {
+        if (runs[i].spilled) unlink(runs[i].fileName);
+    }
+    for (size_t i = 0; i < opened; i++) {
+        csvClose(&inputs[i]);
+    }
+    free(runs);
+    free(inputs);
+    return success;
+}
+
+// The output is written to a temporary file and renamed into place, so merges
+// into the same file may run at once and the last to finish wins
+bool mergeShowroomFiles(const char* const* inputFiles, size_t numInputFiles, const char* outputFileName) {
+    char tempName[MAX_STRING];
+    FILE* outputFile = openCompactionFile(outputFileName, tempName, sizeof(tempName));
+    if (!outputFile) {
+        return false;
+    }
+    setvbuf(outputFile, NULL, _IOFBF, MERGE_OUTPUT_BUFFER);
+    
+    // Header for the output file
+    fprintf(outputFile, "VIN,CarName,Color,Price,FuelType,BodyType,ShowroomID,Available\n");
+    
+    if (!sortMergeFiles(inputFiles, numInputFiles, outputFile, sortMemoryBudget())) {
+        fclose(outputFile);
+        remove(tempName);
+        fprintf(stderr, "Failed to merge showroom data\n");
+        return false;
+    }
+    return finishCompactionFile(outputFile, tempName, outputFileName);
+}
+
+// Required functions from problem statement
+// Merge every showroom feed in the working directory
+void mergeShowrooms(FILE* out, const char* outputFileName) {
+    glob_t matches;
+    if (glob(SHOWROOM_FEED_PATTERN, 0, NULL, &matches) != 0) {
+        fprintf(out, "No showroom files to merge\n");
+        return;
+    }
+    
+    // The showroom table and the output itself match the pattern but are not feeds
+    const char** inputFiles = (const char**)malloc(matches.gl_pathc * sizeof(const char*));
+    if (!inputFiles) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    size_t numInputFiles = 0;
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+        const char* name = matches.gl_pathv[i];
+        if (strcmp(name, SHOWROOM_DATA_FILE) != 0 && strcmp(name, outputFileName) != 0) {
+            inputFiles[numInputFiles++] = name;
+        }
+    }
+    
+    if (numInputFiles == 0) {
+        fprintf(out, "No showroom files to merge\n");
+    } else {
+        uint64_t start = metricsNow();
+        if (mergeShowroomFiles(inputFiles, numInputFiles, outputFileName)) {
+            fprintf(out, "Successfully merged %zu showroom files to %s, sorted by VIN\n", numInputFiles, outputFileName);
+        }
+        recordLatency(METRIC_MERGE, start);
+    }
+    free(inputFiles);
+    globfree(&matches);
+}
+
+void addNewSalesPerson(FILE* out, SalesPerson* salesPerson) {
+    // Generate a new ID if not provided
+    if (strlen(salesPerson->id) == 0) {
+        char* id = createNewId("SP");
+        strcpy(salesPerson->id, id);
+        free(id);
+    }
+    
+    if (!validKeyLength(salesPerson->id)) {
+        fprintf(out, "Sales person ID must be at most %d characters\n", KEY_BYTES);
+        return;
+    }
+    
+    // Insert into linked list and tree
+    if (!insertSalesPersonRecord(salesPerson)) {
+        return;
+    }
+    
+    // Save to file
+    saveSalesPersonToFile(salesPerson);
+    
+    fprintf(out, "Sales person added with ID: %s\n", salesPerson->id);
+}
+
+// Group-by aggregation
+// Counts records per distinct value in one pass over the list using an
+// open-addressing hash table (linear probing, power-of-two capacity, grown at
+// 70% load). Keys point into the records, so a table must not outlive them.
+void groupTableInit(GroupCountTable* table, size_t initialCapacity) {
+    size_t capacity = 16;
+    while (capacity < initialCapacity) capacity <<= 1;
+    
+    table->slots = (GroupCount*)calloc(capacity, sizeof(GroupCount));
+    if (!table->slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    table->capacity = capacity;
+    table->size = 0;
+}
+
+void groupTableFree(GroupCountTable* table) {
+    free(table->slots);
+    table->slots = NULL;
+    table->capacity = 0;
+    table->size = 0;
+}
+
+static GroupCount* groupTableSlot(GroupCount* slots, size_t capacity, const char* key, uint64_t hash) {
+    size_t mask = capacity - 1;
+    size_t i = hash & mask;
+    while (slots[i].key && (slots[i].hash != hash || strcmp(slots[i].key, key) != 0)) {
+        i = (i + 1) & mask;
+    }
+    return &slots[i];
+}
+
+static void groupTableGrow(GroupCountTable* table) {
+    size_t capacity = table->capacity * 2;
+    GroupCount* slots = (GroupCount*)calloc(capacity, sizeof(GroupCount));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    for (size_t i = 0; i < table->capacity; i++) {
+        if (table->slots[i].key) {
+            *groupTableSlot(slots, capacity, table->slots[i].key, table->slots[i].hash) = table->slots[i];
+        }
+    }
+    free(table->slots);
+    table->slots = slots;
+    table->capacity = capacity;
+}
+
+// Add count occurrences of key
+void groupTableAdd(GroupCountTable* table, const char* key, size_t count) {
+    if ((table->size + 1) * 10 > table->capacity * 7) {
+        groupTableGrow(table);
+    }
+    
+    uint64_t hash = hashString(key);
+    GroupCount* slot = groupTableSlot(table->slots, table->capacity, key, hash);
+    if (!slot->key) {
+        slot->key = key;
+        slot->hash = hash;
+        slot->firstSeen = table->size++;
+    }
+    slot->count += count;
+}
+
+static CarDictionary carGroupDictionary(CarGroupField field) {
+    switch (field) {
+        case GROUP_BY_COLOR: return DICT_COLOR;
+        case GROUP_BY_FUEL_TYPE: return DICT_FUEL_TYPE;
+        case GROUP_BY_BODY_TYPE: return DICT_BODY_TYPE;
+        case GROUP_BY_SHOWROOM: return DICT_SHOWROOM;
+        case GROUP_BY_MODEL:
+        default: return DICT_MODEL;
+    }
+}
+
+static DictCode carGroupCode(const Car* car, CarGroupField field) {
+    switch (field) {
+        case GROUP_BY_COLOR: return car->color;
+        case GROUP_BY_FUEL_TYPE: return car->fuelType;
+        case GROUP_BY_BODY_TYPE: return car->bodyType;
+        case GROUP_BY_SHOWROOM: return car->showroomId;
+        case GROUP_BY_MODEL:
+        default: return car->name;
+    }
+}
+
+const char* carGroupValue(const Car* car, CarGroupField field) {
+    return dictionaryString(&carDictionaries[carGroupDictionary(field)], carGroupCode(car, field));
+}
+
+const char* carGroupFieldName(CarGroupField field) {
+    switch (field) {
+        case GROUP_BY_COLOR: return "Color";
+        case GROUP_BY_FUEL_TYPE: return "Fuel Type";
+        case GROUP_BY_BODY_TYPE: return "Body Type";
+        case GROUP_BY_SHOWROOM: return "Showroom";
+        case GROUP_BY_MODEL:
+        default: return "Model";
+    }
+}
+
+// Every groupable field is dictionary encoded, so the pass over the cars counts
+// codes in a dense array and the table sees each distinct value once
+void countCarsBy(CarGroupField field, GroupCountTable* table) {
+    const StringDictionary* dictionary = &carDictionaries[carGroupDictionary(field)];
+    size_t* counts = (size_t*)calloc(dictionary->count, sizeof(size_t));
+    DictCode* firstSeen = (DictCode*)malloc(dictionary->count * sizeof(DictCode));
+    if (!counts || !firstSeen) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    size_t distinct = 0;
+    for (CarNode* current = carList; current; current = current->next) {
+        DictCode code = carGroupCode(&current->car, field);
+        if (counts[code]++ == 0) {
+            firstSeen[distinct++] = code;
+        }
+    }
+    
+    groupTableInit(table, distinct * 2);
+    for (size_t i = 0; i < distinct; i++) {
+        groupTableAdd(table, dictionaryString(dictionary, firstSeen[i]), counts[firstSeen[i]]);
+    }
+    free(firstSeen);
+    free(counts);
+}
+
+// Higher count ranks first; ties go to the value seen first
+static bool groupRanksBefore(const GroupCount* a, const GroupCount* b) {
+    if (a->count != b->count) return a->count > b->count;
+    return a->firstSeen < b->firstSeen;
+}
+
+static void siftDownGroups(GroupCount* heap, size_t size, size_t i) {
+    // Min-heap on rank: the root is the weakest of the current top K
+    for (;;) {
+        size_t weakest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < size && groupRanksBefore(&heap[weakest], &heap[left])) weakest = left;
+        if (right < size && groupRanksBefore(&heap[weakest], &heap[right])) weakest = right;
+        if (weakest == i) return;
+        
+        GroupCount temp = heap[i];
+        heap[i] = heap[weakest];
+        heap[weakest] = temp;
+        i = weakest;
+    }
+}
+
+// Copy the k best ranked groups into out, best first. Returns how many were copied.
+size_t topGroups(const GroupCountTable* table, GroupCount* out, size_t k) {
+    size_t size = 0;
+    if (k == 0) return 0;
+    
+    for (size_t i = 0; i < table->capacity; i++) {
+        const GroupCount* slot = &table->slots[i];
+        if (!slot->key) continue;
+        
+        if (size < k) {
+            out[size++] = *slot;
+            if (size == k) {
+                for (size_t j = k / 2; j-- > 0;) siftDownGroups(out, size, j);
+            }
+        } else if (groupRanksBefore(slot, &out[0])) {
+            out[0] = *slot;
+            siftDownGroups(out, size, 0);
+        }
+    }
+    if (size < k) {
+        for (size_t j = size / 2; j-- > 0;) siftDownGroups(out, size, j);
+    }
+    
+    // Pop the weakest to the back until the array is ordered best first
+    for (size_t end = size; end > 1; end--) {
+        GroupCount temp = out[0];
+        out[0] = out[end - 1];
+        out[end - 1] = temp;
+        siftDownGroups(out, end - 1, 0);
+    }
+    return size;
+}
+
+void printCarGroupReport(FILE* out, CarGroupField field, size_t k) {
+    GroupCountTable table;
+    countCarsBy(field, &table);
+    
+    GroupCount* top = (GroupCount*)malloc((k > 0 ? k : 1) * sizeof(GroupCount));
+    if (!top) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    size_t count = topGroups(&table, top, k);
+    
+    fprintf(out, "\n========== Top %zu by %s (%zu distinct) ==========\n", k, carGroupFieldName(field), table.size);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%zu. %s: %zu cars\n", i + 1, top[i].key[0] ? top[i].key : "(none)", top[i].count);
+    }
+    if (count == 0) {
+        fprintf(out, "No cars found\n");
+    }
+    fprintf(out, "=================================================\n");
+    
+    free(top);
+    groupTableFree(&table);
+}
+
+char* findMostPopularCar() {
+    // Count every model in one pass
+    GroupCountTable table;
+    countCarsBy(GROUP_BY_MODEL, &table);
+    
+    // Find the most popular model
+    GroupCount best;
+    char* mostPopular = (char*)malloc(MAX_STRING);
+    if (!mostPopular) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    mostPopular[0] = '\0';
+    
+    if (topGroups(&table, &best, 1) == 1) {
+        snprintf(mostPopular, MAX_STRING, "%s", best.key);
+    }
+    
+    groupTableFree(&table);
+    return mostPopular;
+}
+
+// Car attribute dictionaries
+// Each distinct string is stored once and cars hold its code. Codes are handed
+// out in first-seen order and never reused, so they stay valid for the life of
+// the process and are written to the snapshot in code order.
+void dictionaryInit(StringDictionary* dictionary) {
+    memset(dictionary, 0, sizeof(*dictionary));
+    dictionaryIntern(dictionary, "");
+}
+
+void dictionaryFree(StringDictionary* dictionary) {
+    for (size_t i = 0; i < dictionary->count; i++) {
+        free(dictionary->values[i]);
+    }
+    free(dictionary->values);
+    free(dictionary->slots);
+    memset(dictionary, 0, sizeof(*dictionary));
+}
+
+static void dictionaryGrowSlots(StringDictionary* dictionary) {
+    size_t numSlots = dictionary->numSlots ? dictionary->numSlots * 2 : 16;
+    uint32_t* slots = (uint32_t*)calloc(numSlots, sizeof(uint32_t));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    for (size_t code = 0; code < dictionary->count; code++) {
+        size_t i = hashString(dictionary->values[code]) & (numSlots - 1);
+        while (slots[i]) {
+            i = (i + 1) & (numSlots - 1);
+        }
+        slots[i] = (uint32_t)code + 1;
+    }
+    free(dictionary->slots);
+    dictionary->slots = slots;
+    dictionary->numSlots = numSlots;
+}
+
+DictCode dictionaryIntern(StringDictionary* dictionary, const char* value) {
+    return dictionaryInternBytes(dictionary, value, strlen(value));
+}
+
+// Intern a value that need not be NUL-terminated, such as a CSV field
+DictCode dictionaryInternBytes(StringDictionary* dictionary, const char* value, size_t length) {
+    if ((dictionary->count + 1) * 10 > dictionary->numSlots * 7) {
+        dictionaryGrowSlots(dictionary);
+    }
+    
+    size_t mask = dictionary->numSlots - 1;
+    size_t i = hashBytes(value, length) & mask;
+    while (dictionary->slots[i]) {
+        DictCode code = (DictCode)(dictionary->slots[i] - 1);
+        const char* existing = dictionary->values[code];
+        if (strncmp(existing, value, length) == 0 && existing[length] == '\0') {
+            return code;
+        }
+        i = (i + 1) & mask;
+    }
+    
+    if (dictionary->count == MAX_DICTIONARY_CODES) {
+        fprintf(stderr, "Too many distinct values for a car attribute\n");
+        exit(1);
+    }
+    if (dictionary->count == dictionary->capacity) {
+        size_t capacity = dictionary->capacity ? dictionary->capacity * 2 : 16;
+        char** values = (char**)realloc(dictionary->values, capacity * sizeof(char*));
+        if (!values) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        dictionary->values = values;
+        dictionary->capacity = capacity;
+    }
+    
+    char* copy = strndup(value, length);
+    if (!copy) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    dictionary->values[dictionary->count] = copy;
+    dictionary->slots[i] = (uint32_t)dictionary->count + 1;
+    return (DictCode)dictionary->count++;
+}
+
+const char* dictionaryString(const StringDictionary* dictionary, DictCode code) {
+    return code < dictionary->count ? dictionary->values[code] : "";
+}
+
+void initializeCarDictionaries() {
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        dictionaryInit(&carDictionaries[i]);
+    }
+    dictionaryIntern(&carDictionaries[DICT_PAYMENT_TYPE], "Cash");
+    loanPaymentCode = dictionaryIntern(&carDictionaries[DICT_PAYMENT_TYPE], "Loan");
+}
+
+DictCode internCarValue(CarDictionary dictionary, const char* value) {
+    return dictionaryIntern(&carDictionaries[dictionary], value);
+}
+
+DictCode internCarField(StringDictionary* dictionaries, CarDictionary dictionary, FieldView field) {
+    return dictionaryInternBytes(&dictionaries[dictionary], field.start, field.length);
+}
+
+const char* carName(const Car* car) {
+    return dictionaryString(&carDictionaries[DICT_MODEL], car->name);
+}
+
+const char* carColor(const Car* car) {
+    return dictionaryString(&carDictionaries[DICT_COLOR], car->color);
+}
+
+const char* carFuelType(const Car* car) {
+    return dictionaryString(&carDictionaries[DICT_FUEL_TYPE], car->fuelType);
+}
+
+const char* carBodyType(const Car* car) {
+    return dictionaryString(&carDictionaries[DICT_BODY_TYPE], car->bodyType);
+}
+
+const char* carShowroomId(const Car* car) {
+    return dictionaryString(&carDictionaries[DICT_SHOWROOM], car->showroomId);
+}
+
+// Sale details of sold cars
+// Sale records are kept in fixed-size segments that are never moved, so a
+// report can read a record while a sale appends the next one.
+CarSale* carSaleAt(size_t index) {
+    return &carSaleSegments[index >> CAR_SALE_SEGMENT_SHIFT][index & ((1UL << CAR_SALE_SEGMENT_SHIFT) - 1)];
+}
+
+CarSale* carSale(const Car* car) {
+    uint32_t saleIndex = __atomic_load_n(&car->saleIndex, __ATOMIC_ACQUIRE);
+    return saleIndex ? carSaleAt(saleIndex - 1) : NULL;
+}
+
+void reserveCarSales(size_t count) {
+    while (carSaleCapacity < count) {
+        size_t segment = carSaleCapacity >> CAR_SALE_SEGMENT_SHIFT;
+        if (segment == MAX_CAR_SALE_SEGMENTS) {
+            fprintf(stderr, "Too many car sales\n");
+            exit(1);
+        }
+        carSaleSegments[segment] = (CarSale*)malloc(sizeof(CarSale) << CAR_SALE_SEGMENT_SHIFT);
+        if (!carSaleSegments[segment]) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        carSaleCapacity += 1UL << CAR_SALE_SEGMENT_SHIFT;
+    }
+}
+
+// Attach a sale record to a car. The car's sale index is set last, so a
+// reader that finds the index also finds the whole record.
+void addCarSale(Car* car, const CarSale* sale) {
+    reserveCarSales(numCarSales + 1);
+    *carSaleAt(numCarSales++) = *sale;
+    __atomic_store_n(&car->saleIndex, (uint32_t)numCarSales, __ATOMIC_RELEASE);
+}
+
+const char* salePaymentType(const CarSale* sale) {
+    return dictionaryString(&carDictionaries[DICT_PAYMENT_TYPE], sale->paymentType);
+}
+
+bool boughtOnLoan(const Car* car) {
+    const CarSale* sale = carSale(car);
+    return !car->available && sale && sale->paymentType == loanPaymentCode;
+}
+
+// Sale snapshots
+// Reports that only need the sales committed at one moment read a snapshot
+// instead of holding off the sellers. A snapshot is just the number of sales
+// committed when it was taken: sale records never move and a car's sale index
+// is published only once its record is complete, so a car is sold in the
+// snapshot iff its sale index is within it. Sales are committed after a whole
+// sale or batch, so a snapshot sees all of a batch or none of it. The one
+// value a sale overwrites, a salesperson's achieved total, keeps its earlier
+// values in a chain for as long as an active snapshot may need them; each
+// sale trims the chain of its salesperson past the oldest active snapshot.
+static pthread_mutex_t snapshotLock = PTHREAD_MUTEX_INITIALIZER;
+static SaleSnapshot* activeSnapshots = NULL;
+
+// Publish the sales applied so far to snapshots taken from now on
+void commitSales() {
+    atomic_store_explicit(&committedSales, numCarSales, memory_order_release);
+}
+
+void beginSnapshot(SaleSnapshot* snapshot) {
+    pthread_mutex_lock(&snapshotLock);
+    snapshot->sequence = atomic_load_explicit(&committedSales, memory_order_acquire);
+    snapshot->prev = NULL;
+    snapshot->next = activeSnapshots;
+    if (activeSnapshots) activeSnapshots->prev = snapshot;
+    activeSnapshots = snapshot;
+    pthread_mutex_unlock(&snapshotLock);
+}
+
+void endSnapshot(SaleSnapshot* snapshot) {
+    pthread_mutex_lock(&snapshotLock);
+    if (snapshot->prev) {
+        snapshot->prev->next = snapshot->next;
+    } else {
+        activeSnapshots = snapshot->next;
+    }
+    if (snapshot->next) snapshot->next->prev = snapshot->prev;
+    pthread_mutex_unlock(&snapshotLock);
+}
+
+// Sales in every active or future snapshot
+static size_t oldestSnapshotSequence() {
+    pthread_mutex_lock(&snapshotLock);
+    size_t oldest = atomic_load_explicit(&committedSales, memory_order_relaxed);
+    for (const SaleSnapshot* snapshot = activeSnapshots; snapshot; snapshot = snapshot->next) {
+        if (snapshot->sequence < oldest) oldest = snapshot->sequence;
+    }
+    pthread_mutex_unlock(&snapshotLock);
+    return oldest;
+}
+
+bool carSoldIn(const Car* car, const SaleSnapshot* snapshot) {
+    uint32_t saleIndex = __atomic_load_n(&car->saleIndex, __ATOMIC_ACQUIRE);
+    return saleIndex != 0 && saleIndex <= snapshot->sequence;
+}
+
+// The live total is read first: a sale pushes the old total before it stores
+// the new one, so a reader that sees the new total also sees the old one
+double salesPersonAchievedIn(const SalesPersonNode* node, const SaleSnapshot* snapshot) {
+    double achieved;
+    __atomic_load(&node->salesPerson.achieved, &achieved, __ATOMIC_ACQUIRE);
+    const AchievedVersion* version = __atomic_load_n(&node->history, __ATOMIC_ACQUIRE);
+    while (version && version->sequence > snapshot->sequence) {
+        achieved = version->before;
+        version = __atomic_load_n(&version->older, __ATOMIC_ACQUIRE);
+    }
+    return achieved;
+}
+
+// A reader of a snapshot stops at the first version at or before its
+// sequence, so the first version at or before the oldest snapshot is kept and
+// only those after it are freed
+static void trimAchievedHistory(SalesPersonNode* node, size_t oldest) {
+    AchievedVersion* keep = node->history;
+    while (keep && keep->sequence > oldest) {
+        keep = keep->older;
+    }
+    if (!keep) {
+        return;
+    }
+    AchievedVersion* version = keep->older;
+    __atomic_store_n(&keep->older, NULL, __ATOMIC_RELEASE);
+    while (version) {
+        AchievedVersion* older = version->older;
+        free(version);
+        version = older;
+    }
+}
+
+// Sales run one at a time, so only readers race with this
+void setSalesPersonAchieved(SalesPersonNode* node, double achieved, size_t sequence) {
+    AchievedVersion* version = (AchievedVersion*)malloc(sizeof(AchievedVersion));
+    if (!version) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    version->sequence = sequence;
+    version->before = node->salesPerson.achieved;
+    version->older = node->history;
+    __atomic_store_n(&node->history, version, __ATOMIC_RELEASE);
+    __atomic_store(&node->salesPerson.achieved, &achieved, __ATOMIC_RELEASE);
+    trimAchievedHistory(node, oldestSnapshotSequence());
+}
+
+void freeAchievedHistory(SalesPersonNode* node) {
+    AchievedVersion* version = node->history;
+    while (version) {
+        AchievedVersion* older = version->older;
+        free(version);
+        version = older;
+    }
+    node->history = NULL;
+}
+
+// Purchase histories
+// Purchases of all customers share one array and each customer links its own
+// in purchase order, so a history costs one small record per car and has no cap.
+// Indexes stored in customers are 1-based positions in purchasePool, except
+// while a loader thread parses customers into a pool of its own.
+const Purchase* purchaseAt(uint32_t index) {
+    return index ? &purchasePool.items[index - 1] : NULL;
+}
+
+void purchasePoolReserve(PurchasePool* pool, size_t count) {
+    if (count <= pool->capacity) {
+        return;
+    }
+    size_t capacity = pool->capacity ? pool->capacity * 2 : 64;
+    while (capacity < count) capacity *= 2;
+    Purchase* grown;
+    if (isSnapshotRecord(pool->items)) {
+        // Still the purchases of a snapshot, used where they are mapped
+        grown = (Purchase*)malloc(capacity * sizeof(Purchase));
+        if (grown) memcpy(grown, pool->items, pool->count * sizeof(Purchase));
+    } else {
+        grown = (Purchase*)realloc(pool->items, capacity * sizeof(Purchase));
+    }
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    pool->items = grown;
+    pool->capacity = capacity;
+}
+
+void addPurchase(PurchasePool* pool, Customer* customer, const char* VIN) {
+    purchasePoolReserve(pool, pool->count + 1);
+    
+    Purchase* purchase = &pool->items[pool->count++];
+    memset(purchase, 0, sizeof(Purchase));
+    copyString(purchase->VIN, sizeof(purchase->VIN), VIN);
+    
+    uint32_t index = (uint32_t)pool->count;
+    if (customer->lastPurchase) {
+        pool->items[customer->lastPurchase - 1].next = index;
+    } else {
+        customer->firstPurchase = index;
+    }
+    customer->lastPurchase = index;
+    customer->numPurchasedCars++;
+}
+
+// Leaderboard
+// The achieved indexes are ordered ascending, so the top N is the last N
+// entries: a descent to the rightmost leaf and N steps back along the leaves.
+size_t topSalesPersons(const char* showroomId, SalesPersonNode** out, size_t n) {
+    BPlusTreeNode* tree = salesPersonAchievedTree;
+    if (showroomId) {
+        int showroomIndex = findShowroomIndex(showroomId);
+        if (showroomIndex < 0) {
+            return 0;
+        }
+        tree = showroomSalesPersonTrees[showroomIndex];
+    }
+    
+    size_t count = 0;
+    TreeCursor cursor;
+    void* value;
+    cursorSeekLast(&cursor, tree);
+    while (count < n && cursorPrev(&cursor, NULL, &value)) {
+        out[count++] = (SalesPersonNode*)value;
+    }
+    return count;
+}
+
+SalesPerson* findMostSuccessfulSalesPerson() {
+    SalesPersonNode* best;
+    if (topSalesPersons(NULL, &best, 1) == 0 || best->salesPerson.achieved <= 0) {
+        return NULL;
+    }
+    return &best->salesPerson;
+}
+
+// Incentive for the most successful salesperson - computed, never added to commission
+double salesPersonIncentive(const SalesPerson* salesPerson) {
+    return salesPerson->achieved * INCENTIVE_RATE;
+}
+
+void printSalesLeaderboard(FILE* out, const char* showroomId, size_t n) {
+    SalesPersonNode** top = (SalesPersonNode**)malloc((n > 0 ? n : 1) * sizeof(SalesPersonNode*));
+    if (!top) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    size_t count = topSalesPersons(showroomId, top, n);
+    fprintf(out, "\n========== Top %zu Sales Persons (%s) ==========\n", n, showroomId ? showroomId : "All showrooms");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%zu. ID: %s, Name: %s, Achieved: %.2f lakhs\n", 
+                     i + 1, top[i]->salesPerson.id, top[i]->salesPerson.name, top[i]->salesPerson.achieved);
+    }
+    if (count == 0) {
+        fprintf(out, "No sales persons found\n");
+    }
+    fprintf(out, "=================================================\n");
+    free(top);
+}
+
+// Check a sale against the current records and look up what it touches
+SaleStatus validateSale(const SaleRequest* request, CarNode** carNode, CustomerNode** customerNode, SalesPersonNode** salesPersonNode) {
+    *carNode = (CarNode*)search(carVinTree, request->VIN);
+    if (!*carNode) {
+        return SALE_CAR_NOT_FOUND;
+    }
+    if (!(*carNode)->car.available) {
+        return SALE_CAR_ALREADY_SOLD;
+    }
+    
+    *customerNode = (CustomerNode*)search(customerTree, request->customerId);
+    if (!*customerNode) {
+        return SALE_CUSTOMER_NOT_FOUND;
+    }
+    
+    *salesPersonNode = (SalesPersonNode*)search(salesPersonTree, request->salesPersonId);
+    if (!*salesPersonNode) {
+        return SALE_SALES_PERSON_NOT_FOUND;
+    }
+    
+    // Check if down payment is sufficient for loan
+    if (strcmp(request->paymentType, "Loan") == 0) {
+        double minDownPayment = ((*carNode)->car.price * MIN_DOWN_PAYMENT_PERCENT) / 100.0;
+        if (request->downPayment < minDownPayment) {
+            return SALE_DOWN_PAYMENT_TOO_LOW;
+        }
+    }
+    return SALE_OK;
+}
+
+void printSaleError(FILE* out, const SaleRequest* request, SaleStatus status) {
+    switch (status) {
+        case SALE_CAR_NOT_FOUND:
+            fprintf(out, "Car not found with VIN: %s\n", request->VIN);
+            break;
+        case SALE_CAR_ALREADY_SOLD:
+            fprintf(out, "Car with VIN %s is already sold\n", request->VIN);
+            break;
+        case SALE_CAR_REPEATED:
+            fprintf(out, "Car with VIN %s appears more than once in the batch\n", request->VIN);
+            break;
+        case SALE_CUSTOMER_NOT_FOUND:
+            fprintf(out, "Customer not found with ID: %s\n", request->customerId);
+            break;
+        case SALE_SALES_PERSON_NOT_FOUND:
+            fprintf(out, "Sales person not found with ID: %s\n", request->salesPersonId);
+            break;
+        case SALE_DOWN_PAYMENT_TOO_LOW: {
+            const CarNode* carNode = (const CarNode*)search(carVinTree, request->VIN);
+            fprintf(out, "Down payment must be at least %.2f (%.2f%% of price)\n", 
+                         carNode ? (carNode->car.price * MIN_DOWN_PAYMENT_PERCENT) / 100.0 : 0.0, 
+                         MIN_DOWN_PAYMENT_PERCENT);
+            break;
+        }
+        case SALE_BATCH_REJECTED:
+            fprintf(out, "Car with VIN %s not sold - another sale in the batch was rejected\n", request->VIN);
+            break;
+        case SALE_OK:
+        default:
+            break;
+    }
+}
+
+void sellCarToCustomer(FILE* out, const char* VIN, const char* customerId, const char* salesPersonId, const char* paymentType, int emiMonths, double downPayment) {
+    uint64_t start = metricsNow();
+    SaleRequest request;
+    memset(&request, 0, sizeof(request));
+    copyString(request.VIN, sizeof(request.VIN), VIN);
+    copyString(request.customerId, sizeof(request.customerId), customerId);
+    copyString(request.salesPersonId, sizeof(request.salesPersonId), salesPersonId);
+    copyString(request.paymentType, sizeof(request.paymentType), paymentType);
+    request.emiMonths = emiMonths;
+    request.downPayment = downPayment;
+    
+    CarNode* carNode;
+    CustomerNode* customerNode;
+    SalesPersonNode* salesPersonNode;
+    SaleStatus status = validateSale(&request, &carNode, &customerNode, &salesPersonNode);
+    if (status != SALE_OK) {
+        printSaleError(out, &request, status);
+        recordLatency(METRIC_SELL, start);
+        return;
+    }
+    
+    // Update in-memory records and persist the sale as a single journal record
+    applySale(carNode, customerNode, salesPersonNode, paymentType, emiMonths, downPayment);
+    commitSales();
+    appendSaleToJournal(&carNode->car);
+    
+    fprintf(out, "Car with VIN %s sold successfully to customer %s\n", VIN, customerNode->customer.name);
+    recordLatency(METRIC_SELL, start);
+}
+
+// Batch sales
+// A batch is all or nothing: every sale is validated against the records and
+// against the rest of the batch before any is applied, and the whole batch
+// goes to the journal in one write between BEGIN and COMMIT markers. Replay
+// only applies batches whose COMMIT made it to disk.
+typedef struct BatchCar {
+    CarNode* node;
+    size_t index;
+} BatchCar;
+
+static int compareBatchCars(const void* a, const void* b) {
+    const BatchCar* left = (const BatchCar*)a;
+    const BatchCar* right = (const BatchCar*)b;
+    uintptr_t leftNode = (uintptr_t)left->node;
+    uintptr_t rightNode = (uintptr_t)right->node;
+    if (leftNode != rightNode) return (leftNode > rightNode) - (leftNode < rightNode);
+    return (left->index > right->index) - (left->index < right->index);
+}
+
+bool sellCars(const SaleRequest* requests, size_t count, SaleStatus* results) {
+    uint64_t start = metricsNow();
+    CarNode** carNodes = (CarNode**)malloc((count > 0 ? count : 1) * sizeof(CarNode*));
+    CustomerNode** customerNodes = (CustomerNode**)malloc((count > 0 ? count : 1) * sizeof(CustomerNode*));
+    SalesPersonNode** salesPersonNodes = (SalesPersonNode**)malloc((count > 0 ? count : 1) * sizeof(SalesPersonNode*));
+    BatchCar* cars = (BatchCar*)malloc((count > 0 ? count : 1) * sizeof(BatchCar));
+    if (!carNodes || !customerNodes || !salesPersonNodes || !cars) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    size_t numValid = 0;
+    size_t numCars = 0;
+    for (size_t i = 0; i < count; i++) {
+        results[i] = validateSale(&requests[i], &carNodes[i], &customerNodes[i], &salesPersonNodes[i]);
+        if (results[i] == SALE_OK) {
+            cars[numCars].node = carNodes[i];
+            cars[numCars].index = i;
+            numCars++;
+        }
+    }
+    
+    // The same car twice - the first sale of it stands, later ones are rejected
+    qsort(cars, numCars, sizeof(BatchCar), compareBatchCars);
+    for (size_t i = 1; i < numCars; i++) {
+        if (cars[i].node == cars[i - 1].node) {
+            results[cars[i].index] = SALE_CAR_REPEATED;
+        }
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (results[i] == SALE_OK) numValid++;
+    }
+    
+    bool committed = (numValid == count);
+    if (committed) {
+        for (size_t i = 0; i < count; i++) {
+            applySale(carNodes[i], customerNodes[i], salesPersonNodes[i], 
+                      requests[i].paymentType, requests[i].emiMonths, requests[i].downPayment);
+        }
+        commitSales();
+        appendSaleBatchToJournal(carNodes, count);
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            if (results[i] == SALE_OK) results[i] = SALE_BATCH_REJECTED;
+        }
+    }
+    
+    free(cars);
+    free(salesPersonNodes);
+    free(customerNodes);
+    free(carNodes);
+    recordLatency(METRIC_SELL_BATCH, start);
+    return committed;
+}
+
+// Fields of a SALE journal record, which is also the batch file format:
+// VIN,customerId,salesPersonId,paymentType,emiMonths,downPayment
+bool parseSaleRequest(const FieldView* fields, size_t numFields, SaleRequest* request) {
+    memset(request, 0, sizeof(SaleRequest));
+    if (numFields < 6 || !validRowKey(fields[0])) {
+        return false;
+    }
+    if (!keyFieldFits(fields[0], "car VIN") || !keyFieldFits(fields[1], "customer ID") || 
+        !keyFieldFits(fields[2], "salesperson ID")) {
+        return false;
+    }
+    
+    copyField(request->VIN, sizeof(request->VIN), fields[0]);
+    copyField(request->customerId, sizeof(request->customerId), fields[1]);
+    copyField(request->salesPersonId, sizeof(request->salesPersonId), fields[2]);
+    copyField(request->paymentType, sizeof(request->paymentType), fields[3]);
+    request->emiMonths = parseFieldInt(fields[4]);
+    request->downPayment = parseFieldDouble(fields[5]);
+    return true;
+}
+
+void sellCarsFromFile(FILE* out, const char* fileName) {
+    CsvReader reader;
+    if (!csvOpen(&reader, fileName)) {
+        fprintf(out, "Failed to open batch file: %s\n", fileName);
+        return;
+    }
+    
+    SaleRequest* requests = NULL;
+    size_t count = 0;
+    size_t capacity = 0;
+    while (csvNextRow(&reader)) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            SaleRequest* grown = (SaleRequest*)realloc(requests, capacity * sizeof(SaleRequest));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            requests = grown;
+        }
+        if (parseSaleRequest(reader.fields, reader.numFields, &requests[count])) {
+            count++;
+        } else if (validRowKey(csvField(reader.fields, reader.numFields, 0))) {
+            // A batch is all or nothing, so a sale that cannot be read sinks it
+            fprintf(out, "Invalid sale record in %s - no cars were sold\n", fileName);
+            csvClose(&reader);
+            free(requests);
+            return;
+        }
+    }
+    csvClose(&reader);
+    
+    if (count == 0) {
+        fprintf(out, "No sales found in %s\n", fileName);
+        free(requests);
+        return;
+    }
+    
+    SaleStatus* results = (SaleStatus*)malloc(count * sizeof(SaleStatus));
+    if (!results) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    bool committed = sellCars(requests, count, results);
+    
+    fprintf(out, "\n============= Batch Sale =============\n");
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "%zu. ", i + 1);
+        if (results[i] == SALE_OK) {
+            fprintf(out, "Car with VIN %s sold to customer %s\n", requests[i].VIN, requests[i].customerId);
+        } else {
+            printSaleError(out, &requests[i], results[i]);
+        }
+    }
+    if (committed) {
+        fprintf(out, "All %zu sales completed\n", count);
+    } else {
+        fprintf(out, "Batch rejected - no cars were sold\n");
+    }
+    fprintf(out, "======================================\n");
+    
+    free(results);
+    free(requests);
+}
+
+void predictNextMonthSales(FILE* out) {
+    // Simple prediction based on previous month sales
+    // In a real implementation, this would use more sophisticated techniques
+    double totalSales = 0;
+    int count = 0;
+    
+    // Totals as of one moment, so sales may go on while this runs
+    SaleSnapshot snapshot;
+    beginSnapshot(&snapshot);
+    SalesPersonNode* current = salesPersonList;
+    while (current) {
+        totalSales += salesPersonAchievedIn(current, &snapshot);
+        count++;
+        current = current->next;
+    }
+    endSnapshot(&snapshot);
+    
+    if (count > 0) {
+        double avgSales = totalSales / count;
+        fprintf(out, "Predicted next month sales: %.2f lakhs\n", avgSales * 1.05);  // 5% growth assumption
+    } else {
+        fprintf(out, "No sales data available for prediction\n");
+    }
+}
+
+void displayCarInfo(FILE* out, const char* VIN) {
+    CarNode* carNode = (CarNode*)search(carVinTree, VIN);
+    if (!carNode) {
+        fprintf(out, "Car not found with VIN: %s\n", VIN);
+        return;
+    }
+    
+    fprintf(out, "\n=================== Car Details ===================\n");
+    const Car* car = &carNode->car;
+    fprintf(out, "VIN: %s\n", car->VIN);
+    fprintf(out, "Name: %s\n", carName(car));
+    fprintf(out, "Color: %s\n", carColor(car));
+    fprintf(out, "Price: %.2f\n", car->price);
+    fprintf(out, "Fuel Type: %s\n", carFuelType(car));
+    fprintf(out, "Body Type: %s\n", carBodyType(car));
+    fprintf(out, "Showroom ID: %s\n", carShowroomId(car));
+    fprintf(out, "Available: %s\n", car->available ? "Yes" : "No");
+    
+    const CarSale* sale = carSale(car);
+    if (!car->available && sale) {
+        fprintf(out, "\n----------------- Sale Details -----------------\n");
+        fprintf(out, "Customer ID: %s\n", sale->customerId);
+        fprintf(out, "Sales Person ID: %s\n", sale->salesPersonId);
+        fprintf(out, "Payment Type: %s\n", salePaymentType(sale));
+        
+        if (sale->paymentType == loanPaymentCode) {
+            fprintf(out, "EMI Months: %d\n", sale->emiMonths);
+            fprintf(out, "Down Payment: %.2f\n", sale->downPayment);
+            fprintf(out, "EMI Rate: %.2f%%\n", sale->emiRate);
+            
+            // Calculate EMI amount
+            double principal = car->price - sale->downPayment;
+            double monthlyRate = sale->emiRate / (12 * 100);
+            double emiAmount = principal * monthlyRate * pow(1 + monthlyRate, sale->emiMonths) / 
+                              (pow(1 + monthlyRate, sale->emiMonths) - 1);
+            
+            fprintf(out, "Monthly EMI: %.2f\n", emiAmount);
+        }
+    }
+    
+    fprintf(out, "==================================================\n");
+}
+
+static void printCarSummary(FILE* out, const Car* car) {
+    fprintf(out, "VIN: %s, Name: %s, Color: %s, Price: %.2f, %s\n", 
+                 car->VIN, carName(car), carColor(car), car->price, 
+                 car->available ? "Available" : "Sold");
+}
+
+void listCarsByVinPrefix(FILE* out, const char* prefix) {
+    // Accept shell-style patterns such as CAR0*
+    char pattern[MAX_STRING];
+    snprintf(pattern, sizeof(pattern), "%s", prefix);
+    pattern[strcspn(pattern, "*")] = '\0';
+    
+    fprintf(out, "\n========== Cars with VIN prefix %s ==========\n", pattern);
+    int count = 0;
+    
+    TreeCursor cursor;
+    void* value;
+    cursorSeekPrefix(&cursor, carVinTree, pattern);
+    while (cursorNext(&cursor, NULL, &value)) {
+        printCarSummary(out, &((CarNode*)value)->car);
+        count++;
+    }
+    
+    if (count == 0) {
+        fprintf(out, "No cars found with the given prefix\n");
+    } else {
+        fprintf(out, "Total: %d cars\n", count);
+    }
+    fprintf(out, "=============================================\n");
+}
+
+void listShowroomInventory(FILE* out, const char* showroomId) {
+    int showroomIndex = findShowroomIndex(showroomId);
+    if (showroomIndex < 0) {
+        fprintf(out, "Showroom not found with ID: %s\n", showroomId);
+        return;
+    }
+    
+    fprintf(out, "\n========== Inventory of %s (%s) ==========\n", 
+                 showrooms[showroomIndex].name, showroomId);
+    int count = 0;
+    
+    TreeCursor cursor;
+    void* value;
+    cursorSeekFirst(&cursor, showroomCarTrees[showroomIndex]);
+    while (cursorNext(&cursor, NULL, &value)) {
+        printCarSummary(out, &((CarNode*)value)->car);
+        count++;
+    }
+    
+    if (count == 0) {
+        fprintf(out, "No cars in this showroom\n");
+    } else {
+        fprintf(out, "Total: %d cars\n", count);
+    }
+    fprintf(out, "=============================================\n");
+}
+
+// Showroom queries
+// Counts and value totals come from the running totals in O(1) per showroom,
+// so the dashboard costs O(showrooms) however many cars there are. Listing
+// the cars themselves scans the showroom's own tree.
+const ShowroomStats* findShowroomStats(const char* showroomId) {
+    int showroomIndex = findShowroomIndex(showroomId);
+    return showroomIndex >= 0 ? &showroomStats[showroomIndex] : NULL;
+}
+
+// Available or sold cars of a showroom in VIN order, as a malloc'd array the
+// caller frees, or NULL if the showroom is not known
+CarNode** findShowroomCars(const char* showroomId, bool available, size_t* count) {
+    *count = 0;
+    int showroomIndex = findShowroomIndex(showroomId);
+    if (showroomIndex < 0) {
+        return NULL;
+    }
+    
+    const ShowroomStats* stats = &showroomStats[showroomIndex];
+    size_t expected = available ? stats->numCars - stats->numSold : stats->numSold;
+    CarNode** results = (CarNode**)malloc((expected > 0 ? expected : 1) * sizeof(CarNode*));
+    if (!results) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    
+    TreeCursor cursor;
+    void* value;
+    cursorSeekFirst(&cursor, showroomCarTrees[showroomIndex]);
+    while (*count < expected && cursorNext(&cursor, NULL, &value)) {
+        CarNode* carNode = (CarNode*)value;
+        if (carNode->car.available == available) {
+            results[(*count)++] = carNode;
+        }
+    }
+    return results;
+}
+
+void listShowroomCars(FILE* out, const char* showroomId, bool available) {
+    size_t count;
+    CarNode** cars = findShowroomCars(showroomId, available, &count);
+    if (!cars) {
+        fprintf(out, "Showroom not found with ID: %s\n", showroomId);
+        return;
+    }
+    
+    fprintf(out, "\n========== %s cars of %s ==========\n", available ? "Available" : "Sold", showroomId);
+    for (size_t i = 0; i < count; i++) {
+        printCarSummary(out, &cars[i]->car);
+    }
+    free(cars);
+    
+    if (count == 0) {
+        fprintf(out, "No %s cars in this showroom\n", available ? "available" : "sold");
+    } else {
+        fprintf(out, "Total: %zu cars\n", count);
+    }
+    fprintf(out, "=============================================\n");
+}
+
+static void printShowroomStats(FILE* out, int showroomIndex) {
+    const Showroom* showroom = &showrooms[showroomIndex];
+    const ShowroomStats* stats = &showroomStats[showroomIndex];
+    fprintf(out, "ID: %s, Name: %s, Cars: %zu, Available: %zu, Sold: %zu, Stock Value: %.2f lakhs, Sold Value: %.2f lakhs\n", 
+                 showroom->id, showroom->name, stats->numCars, stats->numCars - stats->numSold, stats->numSold, 
+                 (stats->totalValue - stats->soldValue) / 100000.0, stats->soldValue / 100000.0);
+}
+
+// One showroom, or every showroom when showroomId is NULL
+void printShowroomDashboard(FILE* out, const char* showroomId) {
+    int showroomIndex = -1;
+    if (showroomId) {
+        showroomIndex = findShowroomIndex(showroomId);
+        if (showroomIndex < 0) {
+            fprintf(out, "Showroom not found with ID: %s\n", showroomId);
+            return;
+        }
+    }
+    
+    fprintf(out, "\n========== Showroom Dashboard ==========\n");
+    if (showroomId) {
+        printShowroomStats(out, showroomIndex);
+    } else {
+        for (int i = 0; i < numShowrooms; i++) {
+            printShowroomStats(out, i);
+        }
+        if (numShowrooms == 0) {
+            fprintf(out, "No showrooms found\n");
+        } else {
+            fprintf(out, "Total: %d showrooms\n", numShowrooms);
+        }
+    }
+    fprintf(out, "========================================\n");
+}
+
+void findSalesPersonByTargetRange(FILE* out, double minSales, double maxSales) {
+    fprintf(out, "\n========== Sales Persons in Target Range %.2f - %.2f ==========\n", minSales, maxSales);
+    int count = 0;
+    
+    // Seek to the lower bound in the achieved index and scan to the upper bound
+    TreeCursor cursor;
+    void* value;
+    cursorSeekRange(&cursor, salesPersonAchievedTree, 
+                    makeNumericKey(minSales, 0), makeNumericKey(maxSales, UINT64_MAX));
+    while (cursorNext(&cursor, NULL, &value)) {
+        SalesPersonNode* current = (SalesPersonNode*)value;
+        fprintf(out, "ID: %s, Name: %s, Achieved: %.2f lakhs\n", 
+                     current->salesPerson.id, current->salesPerson.name, current->salesPerson.achieved);
+        count++;
+    }
+    
+    if (count == 0) {
+        fprintf(out, "No sales persons found in the given range\n");
+    } else {
+        fprintf(out, "Total: %d sales persons\n", count);
+    }
+    fprintf(out, "========================================================\n");
+}
+
+// Loan sales in snapshot with minMonths < emiMonths < maxMonths, joined to their
+// customers. Returns a malloc'd array the caller frees; sales whose customer is
+// unknown are skipped. Sales may be indexed meanwhile.
+LoanSale* findLoanSalesByEmiRange(int minMonths, int maxMonths, const SaleSnapshot* snapshot, size_t* count) {
+    size_t capacity = 16;
+    LoanSale* results = (LoanSale*)malloc(capacity * sizeof(LoanSale));
+    if (!results) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    *count = 0;
+    
+    // Bounds are exclusive, so scan whole months minMonths + 1 .. maxMonths - 1
+    SharedTreeCursor cursor;
+    void* value;
+    sharedCursorSeekRange(&cursor, &loanEmiTree, 
+                          makeNumericKey((double)minMonths + 1, 0), makeNumericKey((double)maxMonths - 1, UINT64_MAX));
+    while (sharedCursorNext(&cursor, NULL, &value)) {
+        LoanSale sale = *(LoanSale*)value;
+        if (!carSoldIn(&sale.car->car, snapshot)) {
+            continue;
+        }
+        if (!sale.customer) {
+            sale.customer = (CustomerNode*)search(customerTree, carSale(&sale.car->car)->customerId);
+            if (!sale.customer) continue;
+        }
+        
+        if (*count == capacity) {
+            capacity *= 2;
+            LoanSale* grown = (LoanSale*)realloc(results, capacity * sizeof(LoanSale));
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            results = grown;
+        }
+        results[(*count)++] = sale;
+    }
+    
+    return results;
+}
+
+void listCustomersByEmiRange(FILE* out, int minMonths, int maxMonths) {
+    fprintf(out, "\n========== Customers with EMI Range %d - %d months ==========\n", minMonths, maxMonths);
+    
+    size_t count;
+    SaleSnapshot snapshot;
+    beginSnapshot(&snapshot);
+    LoanSale* sales = findLoanSalesByEmiRange(minMonths, maxMonths, &snapshot, &count);
+    endSnapshot(&snapshot);
+    for (size_t i = 0; i < count; i++) {
+        fprintf(out, "Customer Name: %s, Car: %s, EMI Months: %d\n", 
+                     sales[i].customer->customer.name, carName(&sales[i].car->car), carSale(&sales[i].car->car)->emiMonths);
+    }
+    free(sales);
+    
+    if (count == 0) {
+        fprintf(out, "No customers found with EMI in the given range\n");
+    } else {
+        fprintf(out, "Total: %zu customers\n", count);
+    }
+    fprintf(out, "=========================================================\n");
+}
+
+void listCustomerCars(FILE* out, const char* customerId) {
+    CustomerNode* customerNode = (CustomerNode*)search(customerTree, customerId);
+    if (!customerNode) {
+        fprintf(out, "Customer not found with ID: %s\n", customerId);
+        return;
+    }
+    
+    fprintf(out, "\n========== Cars owned by %s (%s) ==========\n", customerNode->customer.name, customerId);
+    const Customer* customer = &customerNode->customer;
+    for (const Purchase* purchase = purchaseAt(customer->firstPurchase); purchase; purchase = purchaseAt(purchase->next)) {
+        CarNode* carNode = (CarNode*)search(carVinTree, purchase->VIN);
+        if (carNode) {
+            printCarSummary(out, &carNode->car);
+        } else {
+            fprintf(out, "VIN: %s (no longer in inventory)\n", purchase->VIN);
+        }
+    }
+    
+    if (customer->numPurchasedCars == 0) {
+        fprintf(out, "No cars purchased by this customer\n");
+    } else {
+        fprintf(out, "Total: %u cars\n", customer->numPurchasedCars);
+    }
+    fprintf(out, "=============================================\n");
+}
+
+void freeMemory() {
+    // Records, loan sales and every tree node live in the pools, so the lists
+    // and trees are released a slab at a time without walking them. Only the
+    // achieved histories kept for snapshots are allocated one by one.
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next) {
+        freeAchievedHistory(current);
+    }
+    for (size_t i = 0; i < sizeof(allPools) / sizeof(allPools[0]); i++) {
+        poolReset(allPools[i]);
+    }
+    carList = NULL;
+    salesPersonList = NULL;
+    customerList = NULL;
+    initializeTrees();
+    free(showroomCarTrees);
+    free(showroomSalesPersonTrees);
+    showroomCarTrees = NULL;
+    showroomSalesPersonTrees = NULL;
+    
+    // Free showrooms array, their totals and the ID index
+    free(showrooms);
+    free(showroomStats);
+    free(showroomSlots);
+    showrooms = NULL;
+    showroomStats = NULL;
+    showroomSlots = NULL;
+    numShowrooms = 0;
+    numShowroomSlots = 0;
+    
+    // Free car sale details and attribute dictionaries
+    for (size_t i = 0; i < carSaleCapacity >> CAR_SALE_SEGMENT_SHIFT; i++) {
+        if (!isSnapshotRecord(carSaleSegments[i])) free(carSaleSegments[i]);
+        carSaleSegments[i] = NULL;
+    }
+    numCarSales = carSaleCapacity = 0;
+    commitSales();
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        dictionaryFree(&carDictionaries[i]);
+    }
+    if (!isSnapshotRecord(purchasePool.items)) free(purchasePool.items);
+    memset(&purchasePool, 0, sizeof(purchasePool));
+    
+    // Release the snapshot the loaded records were mapped from
+    if (snapshotMapping) {
+        munmap(snapshotMapping, snapshotSize);
+        snapshotMapping = NULL;
+        snapshotSize = 0;
+    }
+}
+
+// CSV reader
+// Files are mapped and split in place: a row is a list of views into the
+// mapping, so no field is copied until a parser stores it in a record. Field
+// and row boundaries are found 16 bytes at a time with SSE2 where available.
+bool csvOpen(CsvReader* reader, const char* fileName) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    metricsAdd(METRIC_FILES_OPENED, 1);
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    if (st.st_size > 0) {
+        void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+        reader->mapping = mapping;
+        reader->data = (const char*)mapping;
+        reader->size = st.st_size;
+    }
+    close(fd);
+    return true;
+}
+
+// Read rows from memory that stays owned by the caller, such as one chunk of a
+// mapped file
+void csvOpenBuffer(CsvReader* reader, const char* data, size_t size) {
+    memset(reader, 0, sizeof(*reader));
+    reader->data = data;
+    reader->size = size;
+}
+
+void csvClose(CsvReader* reader) {
+    if (reader->mapping) {
+        munmap(reader->mapping, reader->size);
+    }
+    free(reader->fields);
+    memset(reader, 0, sizeof(*reader));
+}
+
+static void csvAddField(CsvReader* reader, const char* start, const char* end) {
+    if (reader->numFields == reader->fieldCapacity) {
+        size_t capacity = reader->fieldCapacity ? reader->fieldCapacity * 2 : 16;
+        FieldView* fields = (FieldView*)realloc(reader->fields, capacity * sizeof(FieldView));
+        if (!fields) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        reader->fields = fields;
+        reader->fieldCapacity = capacity;
+    }
+    reader->fields[reader->numFields].start = start;
+    reader->fields[reader->numFields].length = end - start;
+    reader->numFields++;
+}
+
+// Split the next row into reader->fields. Returns false at the end of the file.
+bool csvNextRow(CsvReader* reader) {
+    const char* p = reader->data + reader->position;
+    const char* end = reader->data + reader->size;
+    if (p >= end) {
+        return false;
+    }
+    
+    reader->numFields = 0;
+    const char* fieldStart = p;
+    const char* lineEnd = NULL;
+    
+#ifdef __SSE2__
+    const __m128i commas = _mm_set1_epi8(',');
+    const __m128i newlines = _mm_set1_epi8('\n');
+    while (!lineEnd && end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, commas), _mm_cmpeq_epi8(chunk, newlines)));
+        while (mask) {
+            const char* delimiter = p + __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (*delimiter == '\n') {
+                lineEnd = delimiter;
+                break;
+            }
+            csvAddField(reader, fieldStart, delimiter);
+            fieldStart = delimiter + 1;
+        }
+        p += 16;
+    }
+#endif
+    
+    for (; !lineEnd && p < end; p++) {
+        if (*p == '\n') {
+            lineEnd = p;
+        } else if (*p == ',') {
+            csvAddField(reader, fieldStart, p);
+            fieldStart = p + 1;
+        }
+    }
+    if (!lineEnd) {
+        lineEnd = end;
+    }
+    
+    // The last field runs to the end of the line, less any carriage return
+    const char* lastEnd = lineEnd;
+    if (lastEnd > fieldStart && lastEnd[-1] == '\r') {
+        lastEnd--;
+    }
+    csvAddField(reader, fieldStart, lastEnd);
+    
+    reader->position = (lineEnd - reader->data) + 1;
+    return true;
+}
+
+FieldView csvField(const FieldView* fields, size_t numFields, size_t index) {
+    FieldView empty = {"", 0};
+    return index < numFields ? fields[index] : empty;
+}
+
+bool fieldEquals(FieldView field, const char* str) {
+    return strlen(str) == field.length && memcmp(field.start, str, field.length) == 0;
+}
+
+// Rows with an empty key and // comment lines carry no record
+bool validRowKey(FieldView key) {
+    if (key.length == 0) return false;
+    return !(key.length >= 2 && key.start[0] == '/' && key.start[1] == '/');
+}
+
+// Keys longer than a tree key are rejected rather than cut short, since two
+// records cut to the same key could no longer be told apart
+bool keyFieldFits(FieldView field, const char* what) {
+    if (field.length <= KEY_BYTES) {
+        return true;
+    }
+    fprintf(stderr, "Skipping %s longer than %d characters: %.*s\n", what, KEY_BYTES, (int)field.length, field.start);
+    return false;
+}
+
+void copyField(char* dest, size_t size, FieldView field) {
+    size_t length = field.length < size - 1 ? field.length : size - 1;
+    memcpy(dest, field.start, length);
+    dest[length] = '\0';
+}
+
+int parseFieldInt(FieldView field) {
+    const char* p = field.start;
+    const char* end = p + field.length;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    // Like atoi, stop at the first non-digit
+    long value = 0;
+    while (p < end && *p >= '0' && *p <= '9' && value < INT32_MAX) {
+        value = value * 10 + (*p++ - '0');
+    }
+    return (int)(negative ? -value : value);
+}
+
+// Plain decimals such as 1800000.00 are converted exactly from an integer
+// mantissa and a power of ten; anything else falls back to strtod
+double parseFieldDouble(FieldView field) {
+    static const double powersOfTen[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    const char* p = field.start;
+    const char* end = p + field.length;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        p++;
+    }
+    
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int fractionDigits = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        mantissa = mantissa * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && *p >= '0' && *p <= '9') {
+            mantissa = mantissa * 10 + (*p++ - '0');
+            digits++;
+            fractionDigits++;
+        }
+    }
+    
+    if (p == end && digits <= 15 && fractionDigits <= 22) {
+        double value = (double)mantissa / powersOfTen[fractionDigits];
+        return negative ? -value : value;
+    }
+    
+    char buffer[64];
+    copyField(buffer, sizeof(buffer), field);
+    return atof(buffer);
+}
+
+// Record parsers shared by the text importer and journal replay. Each takes the
+// fields of one row and returns false for rows that carry no record. They touch
+// no global state, so loader threads can run them side by side: car attributes
+// are interned into the given dictionaries, a sold car's details are returned
+// in *sale for the caller to store, and purchases go to the given pool.
+bool parseCarRecord(const FieldView* fields, size_t numFields, Car* car, CarSale* sale, StringDictionary* dictionaries) {
+    memset(car, 0, sizeof(Car));
+    memset(sale, 0, sizeof(CarSale));
+    if (!validRowKey(csvField(fields, numFields, 0)) || !keyFieldFits(csvField(fields, numFields, 0), "car VIN")) {
+        return false;
+    }
+    bool sold = parseFieldInt(csvField(fields, numFields, 7)) == 0;
+    if (sold && (!keyFieldFits(csvField(fields, numFields, 8), "customer ID") || 
+                 !keyFieldFits(csvField(fields, numFields, 9), "salesperson ID"))) {
+        return false;
+    }
+    
+    copyField(car->VIN, sizeof(car->VIN), csvField(fields, numFields, 0));
+    car->name = internCarField(dictionaries, DICT_MODEL, csvField(fields, numFields, 1));
+    car->color = internCarField(dictionaries, DICT_COLOR, csvField(fields, numFields, 2));
+    car->price = parseFieldDouble(csvField(fields, numFields, 3));
+    car->fuelType = internCarField(dictionaries, DICT_FUEL_TYPE, csvField(fields, numFields, 4));
+    car->bodyType = internCarField(dictionaries, DICT_BODY_TYPE, csvField(fields, numFields, 5));
+    car->showroomId = internCarField(dictionaries, DICT_SHOWROOM, csvField(fields, numFields, 6));
+    car->available = !sold;
+    
+    if (!car->available) {
+        FieldView paymentType = csvField(fields, numFields, 10);
+        copyField(sale->customerId, sizeof(sale->customerId), csvField(fields, numFields, 8));
+        copyField(sale->salesPersonId, sizeof(sale->salesPersonId), csvField(fields, numFields, 9));
+        sale->paymentType = internCarField(dictionaries, DICT_PAYMENT_TYPE, paymentType);
+        
+        if (fieldEquals(paymentType, "Loan")) {
+            sale->emiMonths = parseFieldInt(csvField(fields, numFields, 11));
+            sale->downPayment = parseFieldDouble(csvField(fields, numFields, 12));
+            sale->emiRate = parseFieldDouble(csvField(fields, numFields, 13));
+        }
+    }
+    return true;
+}
+
+bool parseSalesPersonRecord(const FieldView* fields, size_t numFields, SalesPerson* sp) {
+    memset(sp, 0, sizeof(SalesPerson));
+    if (!validRowKey(csvField(fields, numFields, 0)) || !keyFieldFits(csvField(fields, numFields, 0), "salesperson ID")) {
+        return false;
+    }
+    
+    copyField(sp->id, sizeof(sp->id), csvField(fields, numFields, 0));
+    copyField(sp->name, sizeof(sp->name), csvField(fields, numFields, 1));
+    copyField(sp->showroomId, sizeof(sp->showroomId), csvField(fields, numFields, 2));
+    sp->target = parseFieldDouble(csvField(fields, numFields, 3));
+    sp->achieved = parseFieldDouble(csvField(fields, numFields, 4));
+    sp->commission = parseFieldDouble(csvField(fields, numFields, 5));
+    return true;
+}
+
+bool parseCustomerRecord(const FieldView* fields, size_t numFields, Customer* cust, PurchasePool* pool) {
+    memset(cust, 0, sizeof(Customer));
+    if (!validRowKey(csvField(fields, numFields, 0)) || !keyFieldFits(csvField(fields, numFields, 0), "customer ID")) {
+        return false;
+    }
+    
+    copyField(cust->id, sizeof(cust->id), csvField(fields, numFields, 0));
+    copyField(cust->name, sizeof(cust->name), csvField(fields, numFields, 1));
+    copyField(cust->mobileNo, sizeof(cust->mobileNo), csvField(fields, numFields, 2));
+    copyField(cust->address, sizeof(cust->address), csvField(fields, numFields, 3));
+    
+    // The count is followed by that many VINs
+    int numPurchasedCars = parseFieldInt(csvField(fields, numFields, 4));
+    for (int i = 0; i < numPurchasedCars && 5 + (size_t)i < numFields; i++) {
+        if (!keyFieldFits(fields[5 + i], "purchased car VIN")) {
+            continue;
+        }
+        char VIN[KEY_BYTES + 1];
+        copyField(VIN, sizeof(VIN), fields[5 + i]);
+        if (VIN[0]) addPurchase(pool, cust, VIN);
+    }
+    return true;
+}
+
+// Slot of a showroom in showrooms[], or -1 if it is not known
+int findShowroomIndex(const char* showroomId) {
+    if (numShowroomSlots == 0) {
+        return -1;
+    }
+    size_t mask = numShowroomSlots - 1;
+    for (size_t i = hashString(showroomId) & mask; showroomSlots[i]; i = (i + 1) & mask) {
+        if (strcmp(showrooms[showroomSlots[i] - 1].id, showroomId) == 0) {
+            return showroomSlots[i] - 1;
+        }
+    }
+    return -1;
+}
+
+// Hash the showroom IDs, at most half full. The first of a repeated ID wins,
+// as it did when showrooms[] was searched in order.
+static void buildShowroomIndex() {
+    numShowroomSlots = 16;
+    while (numShowroomSlots < (size_t)numShowrooms * 2) numShowroomSlots *= 2;
+    showroomSlots = (int*)calloc(numShowroomSlots, sizeof(int));
+    if (!showroomSlots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    size_t mask = numShowroomSlots - 1;
+    for (int slot = 0; slot < numShowrooms; slot++) {
+        if (findShowroomIndex(showrooms[slot].id) >= 0) {
+            continue;
+        }
+        size_t i = hashString(showrooms[slot].id) & mask;
+        while (showroomSlots[i]) i = (i + 1) & mask;
+        showroomSlots[i] = slot + 1;
+    }
+}
+
+// Add a car to (delta 1) or take it out of (delta -1) its showroom's totals
+static void countShowroomCar(int showroomIndex, const Car* car, int delta) {
+    ShowroomStats* stats = &showroomStats[showroomIndex];
+    stats->numCars += delta;
+    stats->totalValue += delta * car->price;
+    if (!car->available) {
+        stats->numSold += delta;
+        stats->soldValue += delta * car->price;
+    }
+}
+
+// Index helpers - add an already allocated record to the B+ trees
+void indexCarNode(CarNode* node) {
+    // Add to main car tree
+    insertIntoTree(&carVinTree, node->car.VIN, (void*)node);
+    
+    // Add to showroom-specific tree
+    int showroomIndex = findShowroomIndex(carShowroomId(&node->car));
+    if (showroomIndex >= 0) {
+        // A car added again under its VIN replaces the one the tree had
+        CarNode* replaced = (CarNode*)search(showroomCarTrees[showroomIndex], node->car.VIN);
+        insertIntoTree(&showroomCarTrees[showroomIndex], node->car.VIN, (void*)node);
+        if (replaced) countShowroomCar(showroomIndex, &replaced->car, -1);
+        countShowroomCar(showroomIndex, &node->car, 1);
+    }
+    
+    indexLoanSale(node);
+}
+
+// Loan index key - a hash of the VIN keeps sales with equal tenure apart, in an
+// order that does not depend on where or in what order the records were loaded
+static BPlusKey loanEmiKey(const CarNode* node) {
+    return makeNumericKey(carSale(&node->car)->emiMonths, hashString(node->car.VIN));
+}
+
+static LoanSale* createLoanSale(CarNode* node) {
+    LoanSale* sale = (LoanSale*)poolAlloc(&loanSalePool);
+    sale->car = node;
+    sale->customer = (CustomerNode*)search(customerTree, carSale(&node->car)->customerId);
+    return sale;
+}
+
+// Add a sold car to the EMI index if it was bought on a loan
+void indexLoanSale(CarNode* node) {
+    if (!boughtOnLoan(&node->car)) {
+        return;
+    }
+    insertKeyIntoTree(&loanEmiTree, loanEmiKey(node), createLoanSale(node));
+}
+
+void indexSalesPersonNode(SalesPersonNode* node) {
+    insertIntoTree(&salesPersonTree, node->salesPerson.id, (void*)node);
+    insertKeyIntoTree(&salesPersonAchievedTree, salesPersonAchievedKey(node), (void*)node);
+    
+    int showroomIndex = findShowroomIndex(node->salesPerson.showroomId);
+    if (showroomIndex >= 0) {
+        insertKeyIntoTree(&showroomSalesPersonTrees[showroomIndex], salesPersonAchievedKey(node), (void*)node);
+    }
+}
+
+void indexCustomerNode(CustomerNode* node) {
+    insertIntoTree(&customerTree, node->customer.id, (void*)node);
+}
+
+// Allocate a record node and push it on its list
+CarNode* pushCarRecord(const Car* car) {
+    CarNode* newNode = (CarNode*)poolAlloc(&carNodePool);
+
+    memcpy(&newNode->car, car, sizeof(Car));
+    newNode->next = carList;
+    carList = newNode;
+    return newNode;
+}
+
+SalesPersonNode* pushSalesPersonRecord(const SalesPerson* salesPerson) {
+    SalesPersonNode* newNode = (SalesPersonNode*)poolAlloc(&salesPersonNodePool);
+
+    memcpy(&newNode->salesPerson, salesPerson, sizeof(SalesPerson));
+    newNode->history = NULL;
+    newNode->next = salesPersonList;
+    salesPersonList = newNode;
+    return newNode;
+}
+
+CustomerNode* pushCustomerRecord(const Customer* customer) {
+    CustomerNode* newNode = (CustomerNode*)poolAlloc(&customerNodePool);
+
+    memcpy(&newNode->customer, customer, sizeof(Customer));
+    newNode->next = customerList;
+    customerList = newNode;
+    return newNode;
+}
+
+// Push a record on its list and index it
+CarNode* insertCarRecord(const Car* car) {
+    CarNode* newNode = pushCarRecord(car);
+    if (newNode) indexCarNode(newNode);
+    return newNode;
+}
+
+SalesPersonNode* insertSalesPersonRecord(const SalesPerson* salesPerson) {
+    SalesPersonNode* newNode = pushSalesPersonRecord(salesPerson);
+    if (newNode) indexSalesPersonNode(newNode);
+    return newNode;
+}
+
+CustomerNode* insertCustomerRecord(const Customer* customer) {
+    CustomerNode* newNode = pushCustomerRecord(customer);
+    if (newNode) indexCustomerNode(newNode);
+    return newNode;
+}
+
+// Bulk build every tree from the loaded lists. List order is newest first,
+// which is also the record that wins when a key appears more than once.
+// Bucket entries by showroom (-1 for none) and bulk load one tree per showroom
+static void bulkLoadShowroomTrees(BPlusTreeNode** trees, const TreeEntry* entries, const int* showroomOf, size_t count) {
+    if (numShowrooms == 0 || !trees) {
+        return;
+    }
+    
+    size_t* offsets = (size_t*)calloc(numShowrooms + 1, sizeof(size_t));
+    TreeEntry* byShowroom = allocTreeEntries(count);
+    if (!offsets) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (showroomOf[i] >= 0) offsets[showroomOf[i] + 1]++;
+    }
+    for (int i = 0; i < numShowrooms; i++) {
+        offsets[i + 1] += offsets[i];
+    }
+    
+    size_t* fill = (size_t*)malloc((numShowrooms + 1) * sizeof(size_t));
+    if (!fill) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(fill, offsets, (numShowrooms + 1) * sizeof(size_t));
+    for (size_t i = 0; i < count; i++) {
+        if (showroomOf[i] >= 0) {
+            byShowroom[fill[showroomOf[i]]++] = entries[i];
+        }
+    }
+    for (int i = 0; i < numShowrooms; i++) {
+        bulkLoadTree(&trees[i], byShowroom + offsets[i], offsets[i + 1] - offsets[i], BULK_LOAD_FILL_FACTOR);
+    }
+    
+    free(fill);
+    free(byShowroom);
+    free(offsets);
+}
+
+static int* allocShowroomSlots(size_t count) {
+    int* slots = (int*)malloc((count > 0 ? count : 1) * sizeof(int));
+    if (!slots) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return slots;
+}
+
+// Entries for the records of a snapshot in one of its stored key orders. The
+// sequence numbers are list positions, as if the entries came from the list.
+static TreeEntry* snapshotOrderEntries(const SnapshotIndexes* snapshot, IndexOrder order, void* records, size_t recordSize, size_t* count) {
+    *count = snapshot->orderCounts[order];
+    TreeEntry* entries = allocTreeEntries(*count);
+    for (size_t i = 0; i < *count; i++) {
+        size_t position = snapshot->orders[order][i];
+        entries[i].value = (char*)records + position * recordSize;
+        entries[i].seq = position;
+    }
+    return entries;
+}
+
+// Every car in list order, without keys
+static TreeEntry* listCarEntries(size_t* numCars) {
+    size_t count = 0;
+    for (CarNode* current = carList; current; current = current->next) count++;
+    
+    TreeEntry* entries = allocTreeEntries(count);
+    count = 0;
+    for (CarNode* current = carList; current; current = current->next, count++) {
+        entries[count].value = current;
+        entries[count].seq = count;
+    }
+    *numCars = count;
+    return entries;
+}
+
+static TreeEntry* collectCarEntries(const SnapshotIndexes* snapshot, size_t* numCars) {
+    TreeEntry* entries = snapshot ? 
+                         snapshotOrderEntries(snapshot, ORDER_CAR_VIN, snapshot->cars, sizeof(CarNode), numCars) : 
+                         listCarEntries(numCars);
+    for (size_t i = 0; i < *numCars; i++) {
+        entries[i].key = makeStringKey(((CarNode*)entries[i].value)->car.VIN);
+    }
+    return entries;
+}
+
+static void buildCarVinIndex(const SnapshotIndexes* snapshot) {
+    size_t numCars;
+    TreeEntry* entries = collectCarEntries(snapshot, &numCars);
+    bulkLoadTree(&carVinTree, entries, numCars, BULK_LOAD_FILL_FACTOR);
+    free(entries);
+}
+
+// Each showroom gets its cars in the order they are given, so VIN order
+// from a snapshot needs no sorting either
+static void buildShowroomCarIndexes(const SnapshotIndexes* snapshot) {
+    size_t numCars;
+    TreeEntry* entries = collectCarEntries(snapshot, &numCars);
+    int* showroomOf = allocShowroomSlots(numCars);
+    for (size_t i = 0; i < numCars; i++) {
+        showroomOf[i] = findShowroomIndex(carShowroomId(&((CarNode*)entries[i].value)->car));
+    }
+    bulkLoadShowroomTrees(showroomCarTrees, entries, showroomOf, numCars);
+    free(entries);
+    free(showroomOf);
+    
+    // Totals are taken from the trees, so a repeated VIN counts once
+    for (int i = 0; i < numShowrooms && showroomCarTrees; i++) {
+        memset(&showroomStats[i], 0, sizeof(ShowroomStats));
+        TreeCursor cursor;
+        void* value;
+        cursorSeekFirst(&cursor, showroomCarTrees[i]);
+        while (cursorNext(&cursor, NULL, &value)) {
+            countShowroomCar(i, &((CarNode*)value)->car, 1);
+        }
+    }
+}
+
+static TreeEntry* collectSalesPersonEntries(const SnapshotIndexes* snapshot, IndexOrder order, size_t* numSalesPersons) {
+    if (snapshot) {
+        return snapshotOrderEntries(snapshot, order, snapshot->salesPersons, sizeof(SalesPersonNode), numSalesPersons);
+    }
+    size_t count = 0;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next) count++;
+    TreeEntry* entries = allocTreeEntries(count);
+    count = 0;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next, count++) {
+        entries[count].value = current;
+        entries[count].seq = count;
+    }
+    *numSalesPersons = count;
+    return entries;
+}
+
+static void buildSalesPersonIndexes(const SnapshotIndexes* snapshot) {
+    size_t numSalesPersons;
+    TreeEntry* entries = collectSalesPersonEntries(snapshot, ORDER_SALESPERSON_ID, &numSalesPersons);
+    for (size_t i = 0; i < numSalesPersons; i++) {
+        entries[i].key = makeStringKey(((SalesPersonNode*)entries[i].value)->salesPerson.id);
+    }
+    bulkLoadTree(&salesPersonTree, entries, numSalesPersons, BULK_LOAD_FILL_FACTOR);
+    free(entries);
+    
+    // Achieved indexes
+    entries = collectSalesPersonEntries(snapshot, ORDER_SALESPERSON_ACHIEVED, &numSalesPersons);
+    int* showroomOf = allocShowroomSlots(numSalesPersons);
+    for (size_t i = 0; i < numSalesPersons; i++) {
+        SalesPersonNode* node = (SalesPersonNode*)entries[i].value;
+        entries[i].key = salesPersonAchievedKey(node);
+        showroomOf[i] = findShowroomIndex(node->salesPerson.showroomId);
+    }
+    bulkLoadShowroomTrees(showroomSalesPersonTrees, entries, showroomOf, numSalesPersons);
+    bulkLoadTree(&salesPersonAchievedTree, entries, numSalesPersons, BULK_LOAD_FILL_FACTOR);
+    free(entries);
+    free(showroomOf);
+}
+
+static void buildCustomerIndex(const SnapshotIndexes* snapshot) {
+    size_t numCustomers = 0;
+    TreeEntry* entries;
+    if (snapshot) {
+        entries = snapshotOrderEntries(snapshot, ORDER_CUSTOMER_ID, snapshot->customers, sizeof(CustomerNode), &numCustomers);
+    } else {
+        for (CustomerNode* current = customerList; current; current = current->next) numCustomers++;
+        entries = allocTreeEntries(numCustomers);
+        size_t count = 0;
+        for (CustomerNode* current = customerList; current; current = current->next, count++) {
+            entries[count].value = current;
+            entries[count].seq = count;
+        }
+    }
+    for (size_t i = 0; i < numCustomers; i++) {
+        entries[i].key = makeStringKey(((CustomerNode*)entries[i].value)->customer.id);
+    }
+    bulkLoadTree(&customerTree, entries, numCustomers, BULK_LOAD_FILL_FACTOR);
+    free(entries);
+}
+
+static void buildLoanIndex(const SnapshotIndexes* snapshot) {
+    size_t numCars;
+    TreeEntry* entries = snapshot ? 
+                         snapshotOrderEntries(snapshot, ORDER_LOAN_EMI, snapshot->cars, sizeof(CarNode), &numCars) : 
+                         listCarEntries(&numCars);
+    size_t count = 0;
+    for (size_t i = 0; i < numCars; i++) {
+        CarNode* node = (CarNode*)entries[i].value;
+        if (!boughtOnLoan(&node->car)) {
+            continue;
+        }
+        entries[count].key = loanEmiKey(node);
+        entries[count].value = createLoanSale(node);
+        entries[count].seq = entries[i].seq;
+        count++;
+    }
+    bulkLoadTree(&loanEmiTree, entries, count, BULK_LOAD_FILL_FACTOR);
+    free(entries);
+}
+
+static void (*const indexBuilders[])(const SnapshotIndexes*) = {
+    buildCarVinIndex, buildShowroomCarIndexes, buildSalesPersonIndexes, buildCustomerIndex
+};
+
+static void buildIndexTask(void* context, size_t index) {
+    indexBuilders[index]((const SnapshotIndexes*)context);
+}
+
+// The trees share nothing but the node pool, so they are built side by side.
+// Loan sales are joined to customers, so that index is built last. Built from
+// a snapshot, the entries come in its stored key orders and are not sorted.
+void buildIndexes(const SnapshotIndexes* snapshot) {
+    parallelFor(sizeof(indexBuilders) / sizeof(indexBuilders[0]), buildIndexTask, (void*)snapshot);
+    buildLoanIndex(snapshot);
+}
+
+// Set up the per-showroom trees, totals and ID index once the showroom table is known
+static void initializeShowrooms() {
+    size_t slots = numShowrooms > 0 ? numShowrooms : 1;
+    showroomCarTrees = (BPlusTreeNode**)calloc(slots, sizeof(BPlusTreeNode*));
+    showroomSalesPersonTrees = (BPlusTreeNode**)calloc(slots, sizeof(BPlusTreeNode*));
+    showroomStats = (ShowroomStats*)calloc(slots, sizeof(ShowroomStats));
+    if (!showroomCarTrees || !showroomSalesPersonTrees || !showroomStats) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    buildShowroomIndex();
+}
+
+// Parallel text import
+// Each data file is mapped once and cut into chunks at line boundaries. Loader
+// threads parse the chunks side by side into record nodes from chunk-local
+// pools - cars against chunk-local dictionaries, customers into a chunk-local
+// purchase pool. The small dictionaries are then merged into the global ones
+// in file order, the threads translate their chunks' codes and indexes in
+// place, and the chunks' lists and slabs are spliced onto the global ones. The
+// lists come out exactly as a sequential load would build them.
+static void splitLoadChunks(LoadChunk** chunks, size_t* numChunks, size_t* capacity, DataFileType type, const char* data, size_t size) {
+    size_t chunkBytes = size / (workerThreadCount() * 4);
+    if (chunkBytes < LOAD_CHUNK_BYTES) chunkBytes = LOAD_CHUNK_BYTES;
+    
+    size_t start = 0;
+    while (start < size) {
+        size_t end = size;
+        if (size - start > chunkBytes) {
+            const char* newline = (const char*)memchr(data + start + chunkBytes, '\n', size - start - chunkBytes);
+            end = newline ? (size_t)(newline - data) + 1 : size;
+        }
+        
+        if (*numChunks == *capacity) {
+            size_t grown = *capacity ? *capacity * 2 : 16;
+            LoadChunk* resized = (LoadChunk*)realloc(*chunks, grown * sizeof(LoadChunk));
+            if (!resized) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            *chunks = resized;
+            *capacity = grown;
+        }
+        LoadChunk* chunk = &(*chunks)[(*numChunks)++];
+        memset(chunk, 0, sizeof(*chunk));
+        chunk->type = type;
+        chunk->data = data + start;
+        chunk->size = end - start;
+        start = end;
+    }
+}
+
+static void parseCarChunk(LoadChunk* chunk, CsvReader* reader) {
+    poolInitLike(&chunk->nodes, &carNodePool);
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        dictionaryInit(&chunk->dictionaries[i]);
+    }
+    
+    while (csvNextRow(reader)) {
+        Car car;
+        CarSale sale;
+        if (!parseCarRecord(reader->fields, reader->numFields, &car, &sale, chunk->dictionaries)) {
+            continue;
+        }
+        if (!car.available) {
+            if (chunk->numSales == chunk->saleCapacity) {
+                size_t capacity = chunk->saleCapacity ? chunk->saleCapacity * 2 : 64;
+                CarSale* grown = (CarSale*)realloc(chunk->sales, capacity * sizeof(CarSale));
+                if (!grown) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+                chunk->sales = grown;
+                chunk->saleCapacity = capacity;
+            }
+            chunk->sales[chunk->numSales++] = sale;
+            car.saleIndex = (uint32_t)chunk->numSales;
+        }
+        
+        CarNode* node = (CarNode*)poolAlloc(&chunk->nodes);
+        node->car = car;
+        node->next = (CarNode*)chunk->head;
+        if (!chunk->head) chunk->tail = node;
+        chunk->head = node;
+    }
+}
+
+static void parseSalesPersonChunk(LoadChunk* chunk, CsvReader* reader) {
+    poolInitLike(&chunk->nodes, &salesPersonNodePool);
+    while (csvNextRow(reader)) {
+        SalesPerson sp;
+        if (!parseSalesPersonRecord(reader->fields, reader->numFields, &sp)) {
+            continue;
+        }
+        SalesPersonNode* node = (SalesPersonNode*)poolAlloc(&chunk->nodes);
+        node->salesPerson = sp;
+        node->history = NULL;
+        node->next = (SalesPersonNode*)chunk->head;
+        if (!chunk->head) chunk->tail = node;
+        chunk->head = node;
+    }
+}
+
+static void parseCustomerChunk(LoadChunk* chunk, CsvReader* reader) {
+    poolInitLike(&chunk->nodes, &customerNodePool);
+    while (csvNextRow(reader)) {
+        Customer cust;
+        if (!parseCustomerRecord(reader->fields, reader->numFields, &cust, &chunk->purchases)) {
+            continue;
+        }
+        CustomerNode* node = (CustomerNode*)poolAlloc(&chunk->nodes);
+        node->customer = cust;
+        node->next = (CustomerNode*)chunk->head;
+        if (!chunk->head) chunk->tail = node;
+        chunk->head = node;
+    }
+}
+
+static void parseLoadChunk(void* context, size_t index) {
+    LoadChunk* chunk = &((LoadChunk*)context)[index];
+    CsvReader reader;
+    csvOpenBuffer(&reader, chunk->data, chunk->size);
+    if (chunk->type == DATA_CARS) {
+        parseCarChunk(chunk, &reader);
+    } else if (chunk->type == DATA_SALES_PERSONS) {
+        parseSalesPersonChunk(chunk, &reader);
+    } else {
+        parseCustomerChunk(chunk, &reader);
+    }
+    csvClose(&reader);
+}
+
+// Give the chunk its global dictionary codes and its place in the shared
+// sale and purchase arrays. Runs on one thread, in file order.
+static void placeLoadChunk(LoadChunk* chunk) {
+    if (chunk->type == DATA_CARS) {
+        for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+            const StringDictionary* local = &chunk->dictionaries[i];
+            chunk->codes[i] = (DictCode*)malloc(local->count * sizeof(DictCode));
+            if (!chunk->codes[i]) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            for (size_t code = 0; code < local->count; code++) {
+                chunk->codes[i][code] = dictionaryIntern(&carDictionaries[i], local->values[code]);
+            }
+        }
+        chunk->saleBase = numCarSales;
+        reserveCarSales(numCarSales + chunk->numSales);
+        numCarSales += chunk->numSales;
+    } else if (chunk->type == DATA_CUSTOMERS) {
+        chunk->purchaseBase = purchasePool.count;
+        purchasePoolReserve(&purchasePool, purchasePool.count + chunk->purchases.count);
+        purchasePool.count += chunk->purchases.count;
+    }
+}
+
+// Rewrite the chunk's records in terms of the global codes and indexes
+static void translateLoadChunk(void* context, size_t index) {
+    LoadChunk* chunk = &((LoadChunk*)context)[index];
+    if (chunk->type == DATA_CARS) {
+        DictCode** codes = chunk->codes;
+        for (CarNode* node = (CarNode*)chunk->head; node; node = node->next) {
+            Car* car = &node->car;
+            car->name = codes[DICT_MODEL][car->name];
+            car->color = codes[DICT_COLOR][car->color];
+            car->fuelType = codes[DICT_FUEL_TYPE][car->fuelType];
+            car->bodyType = codes[DICT_BODY_TYPE][car->bodyType];
+            car->showroomId = codes[DICT_SHOWROOM][car->showroomId];
+            if (car->saleIndex) car->saleIndex += (uint32_t)chunk->saleBase;
+        }
+        for (size_t i = 0; i < chunk->numSales; i++) {
+            CarSale* sale = carSaleAt(chunk->saleBase + i);
+            *sale = chunk->sales[i];
+            sale->paymentType = codes[DICT_PAYMENT_TYPE][sale->paymentType];
+        }
+    } else if (chunk->type == DATA_CUSTOMERS) {
+        uint32_t base = (uint32_t)chunk->purchaseBase;
+        for (CustomerNode* node = (CustomerNode*)chunk->head; node; node = node->next) {
+            if (node->customer.firstPurchase) {
+                node->customer.firstPurchase += base;
+                node->customer.lastPurchase += base;
+            }
+        }
+        for (size_t i = 0; i < chunk->purchases.count; i++) {
+            Purchase* purchase = &purchasePool.items[base + i];
+            *purchase = chunk->purchases.items[i];
+            if (purchase->next) purchase->next += base;
+        }
+    }
+}
+
+// Put the chunk's records in front of the global list, which keeps the list
+// newest first, and hand its slabs to the global pool
+static void spliceLoadChunk(LoadChunk* chunk) {
+    if (chunk->head) {
+        if (chunk->type == DATA_CARS) {
+            ((CarNode*)chunk->tail)->next = carList;
+            carList = (CarNode*)chunk->head;
+            poolAdopt(&carNodePool, &chunk->nodes);
+        } else if (chunk->type == DATA_SALES_PERSONS) {
+            ((SalesPersonNode*)chunk->tail)->next = salesPersonList;
+            salesPersonList = (SalesPersonNode*)chunk->head;
+            poolAdopt(&salesPersonNodePool, &chunk->nodes);
+        } else {
+            ((CustomerNode*)chunk->tail)->next = customerList;
+            customerList = (CustomerNode*)chunk->head;
+            poolAdopt(&customerNodePool, &chunk->nodes);
+        }
+    }
+    
+    poolReset(&chunk->nodes);
+    pthread_mutex_destroy(&chunk->nodes.lock);
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        free(chunk->codes[i]);
+        dictionaryFree(&chunk->dictionaries[i]);
+    }
+    free(chunk->sales);
+    free(chunk->purchases.items);
+}
+
+// Text import - the comma-separated data files
+void importTextFiles() {
+    CsvReader reader;
+    
+    // Load showrooms
+    if (csvOpen(&reader, SHOWROOM_DATA_FILE)) {
+        int capacity = 4;
+        numShowrooms = 0;
+        showrooms = (Showroom*)malloc(capacity * sizeof(Showroom));
+        if (!showrooms) {
+            fprintf(stderr, "Memory allocation failed\n");
             exit(1);
         }
+        
+        while (csvNextRow(&reader)) {
+            if (!validRowKey(reader.fields[0])) {
+                continue;
+            }
+            if (numShowrooms == capacity) {
+                capacity *= 2;
+                Showroom* grown = (Showroom*)realloc(showrooms, capacity * sizeof(Showroom));
+                if (!grown) {
+                    fprintf(stderr, "Memory allocation failed\n");
+                    exit(1);
+                }
+                showrooms = grown;
+            }
+            
+            Showroom* showroom = &showrooms[numShowrooms++];
+            copyField(showroom->id, sizeof(showroom->id), csvField(reader.fields, reader.numFields, 0));
+            copyField(showroom->name, sizeof(showroom->name), csvField(reader.fields, reader.numFields, 1));
+            copyField(showroom->manufacturer, sizeof(showroom->manufacturer), csvField(reader.fields, reader.numFields, 2));
+        }
+        csvClose(&reader);
+        
+        // Initialize showroom-specific car trees
+        initializeShowrooms();
     }
-    fclose(file);
     
-    // Check salesperson data file
-    file = fopen(SALESPERSON_DATA_FILE, "r");
-    if (!file) {
-        file = fopen(SALESPERSON_DATA_FILE, "w");
-        if (!file) {
-            fprintf(stderr, "Failed to create salesperson data file\n");
-            exit(1);
+    // Cars, salespeople and customers are parsed in parallel, then merged
+    const char* fileNames[NUM_DATA_FILES] = { CAR_DATA_FILE, SALESPERSON_DATA_FILE, CUSTOMER_DATA_FILE };
+    CsvReader files[NUM_DATA_FILES];
+    LoadChunk* chunks = NULL;
+    size_t numChunks = 0;
+    size_t chunkCapacity = 0;
+    for (int i = 0; i < NUM_DATA_FILES; i++) {
+        if (csvOpen(&files[i], fileNames[i])) {
+            splitLoadChunks(&chunks, &numChunks, &chunkCapacity, (DataFileType)i, files[i].data, files[i].size);
         }
     }
-    fclose(file);
     
-    // Check customer data file
-    file = fopen(CUSTOMER_DATA_FILE, "r");
-    if (!file) {
-        file = fopen(CUSTOMER_DATA_FILE, "w");
-        if (!file) {
-            fprintf(stderr, "Failed to create customer data file\n");
-            exit(1);
+    parallelFor(numChunks, parseLoadChunk, chunks);
+    for (size_t i = 0; i < numChunks; i++) {
+        placeLoadChunk(&chunks[i]);
+    }
+    parallelFor(numChunks, translateLoadChunk, chunks);
+    for (size_t i = 0; i < numChunks; i++) {
+        spliceLoadChunk(&chunks[i]);
+    }
+    free(chunks);
+    for (int i = 0; i < NUM_DATA_FILES; i++) {
+        csvClose(&files[i]);
+    }
+    
+    buildIndexes(NULL);
+}
+
+// Text export - rewrite every data file from the in-memory lists
+bool exportTextFiles() {
+    char tempName[MAX_STRING];
+    
+    FILE* carFile = openCompactionFile(CAR_DATA_FILE, tempName, sizeof(tempName));
+    if (!carFile) return false;
+    for (CarNode* current = carList; current; current = current->next) {
+        writeCarRecord(carFile, &current->car);
+    }
+    if (!finishCompactionFile(carFile, tempName, CAR_DATA_FILE)) return false;
+    
+    FILE* customerFile = openCompactionFile(CUSTOMER_DATA_FILE, tempName, sizeof(tempName));
+    if (!customerFile) return false;
+    for (CustomerNode* current = customerList; current; current = current->next) {
+        writeCustomerRecord(customerFile, &current->customer);
+    }
+    if (!finishCompactionFile(customerFile, tempName, CUSTOMER_DATA_FILE)) return false;
+    
+    FILE* salesPersonFile = openCompactionFile(SALESPERSON_DATA_FILE, tempName, sizeof(tempName));
+    if (!salesPersonFile) return false;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next) {
+        writeSalesPersonRecord(salesPersonFile, &current->salesPerson);
+    }
+    return finishCompactionFile(salesPersonFile, tempName, SALESPERSON_DATA_FILE);
+}
+
+// Binary snapshot
+// Layout: SnapshotHeader followed by one section per record type. Each section
+// is an array of fixed-size records aligned to SNAPSHOT_ALIGNMENT, stored as the
+// list node structs themselves with each next pointer already aimed at the
+// following record as mapped at SNAPSHOT_BASE_ADDRESS. Loading maps the file
+// privately at that address when it is free, so the lists start on the mapped
+// records without a byte of them written; mapped anywhere else, the links are
+// fixed up first. Car sale details and purchase histories follow and are used
+// where they are mapped too (but for a partly filled last segment of sales),
+// and the attribute dictionaries the car codes refer to are interned again.
+// Each index's key order is stored as well, so the trees are bulk loaded
+// without sorting - they are still built at load, not mapped. Later updates to
+// mapped records stay in process memory until the next snapshot.
+bool isSnapshotRecord(const void* record) {
+    return snapshotMapping && 
+           (const char*)record >= (const char*)snapshotMapping && 
+           (const char*)record < (const char*)snapshotMapping + snapshotSize;
+}
+
+static uint64_t alignSnapshotOffset(FILE* file, uint64_t offset) {
+    while (offset % SNAPSHOT_ALIGNMENT != 0) {
+        fputc(0, file);
+        offset++;
+    }
+    return offset;
+}
+
+// Where a record at the given file offset will be when the snapshot is mapped at SNAPSHOT_BASE_ADDRESS
+static void* snapshotAddress(uint64_t offset) {
+    return (void*)(uintptr_t)(SNAPSHOT_BASE_ADDRESS + offset);
+}
+
+// Sort the entries by key, ties in list order, and write their list positions
+static uint64_t writeSnapshotOrder(FILE* file, SnapshotHeader* header, IndexOrder order, TreeEntry* entries, size_t count, uint64_t offset) {
+    offset = alignSnapshotOffset(file, offset);
+    sortTreeEntries(entries, count);
+    header->orderOffsets[order] = offset;
+    header->orderCounts[order] = count;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t position = (uint32_t)entries[i].seq;
+        fwrite(&position, sizeof(position), 1, file);
+    }
+    return offset + count * sizeof(uint32_t);
+}
+
+bool writeSnapshot(const char* fileName) {
+    char tempName[MAX_STRING];
+    FILE* file = openCompactionFile(fileName, tempName, sizeof(tempName));
+    if (!file) return false;
+    
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.showroomRecordSize = sizeof(Showroom);
+    header.carRecordSize = sizeof(CarNode);
+    header.salesPersonRecordSize = sizeof(SalesPersonNode);
+    header.customerRecordSize = sizeof(CustomerNode);
+    header.saleRecordSize = sizeof(CarSale);
+    header.numDictionaries = NUM_CAR_DICTIONARIES;
+    header.purchaseRecordSize = sizeof(Purchase);
+    fwrite(&header, sizeof(header), 1, file);  // Rewritten once the counts are known
+    uint64_t offset = sizeof(header);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.showroomOffset = offset;
+    header.numShowrooms = numShowrooms;
+    fwrite(showrooms, sizeof(Showroom), numShowrooms, file);
+    offset += (uint64_t)numShowrooms * sizeof(Showroom);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.carOffset = offset;
+    for (CarNode* current = carList; current; current = current->next) {
+        CarNode record = *current;
+        record.next = current->next ? (CarNode*)snapshotAddress(offset + (header.numCars + 1) * sizeof(CarNode)) : NULL;
+        fwrite(&record, sizeof(record), 1, file);
+        header.numCars++;
+    }
+    offset += header.numCars * sizeof(CarNode);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.salesPersonOffset = offset;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next) {
+        SalesPersonNode record = *current;
+        record.next = current->next ? 
+                      (SalesPersonNode*)snapshotAddress(offset + (header.numSalesPersons + 1) * sizeof(SalesPersonNode)) : NULL;
+        record.history = NULL;
+        fwrite(&record, sizeof(record), 1, file);
+        header.numSalesPersons++;
+    }
+    offset += header.numSalesPersons * sizeof(SalesPersonNode);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.customerOffset = offset;
+    for (CustomerNode* current = customerList; current; current = current->next) {
+        CustomerNode record = *current;
+        record.next = current->next ? 
+                      (CustomerNode*)snapshotAddress(offset + (header.numCustomers + 1) * sizeof(CustomerNode)) : NULL;
+        fwrite(&record, sizeof(record), 1, file);
+        header.numCustomers++;
+    }
+    offset += header.numCustomers * sizeof(CustomerNode);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.saleOffset = offset;
+    header.numSales = numCarSales;
+    for (size_t i = 0; i < numCarSales; i += 1UL << CAR_SALE_SEGMENT_SHIFT) {
+        size_t run = numCarSales - i < (1UL << CAR_SALE_SEGMENT_SHIFT) ? numCarSales - i : 1UL << CAR_SALE_SEGMENT_SHIFT;
+        fwrite(carSaleAt(i), sizeof(CarSale), run, file);
+    }
+    offset += header.numSales * sizeof(CarSale);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.purchaseOffset = offset;
+    header.numPurchases = purchasePool.count;
+    if (purchasePool.count > 0) {
+        fwrite(purchasePool.items, sizeof(Purchase), purchasePool.count, file);
+    }
+    offset += header.numPurchases * sizeof(Purchase);
+    
+    // Key orders of the indexes, from the lists as buildIndexes would see them
+    size_t maxRecords = header.numCars;
+    if (header.numSalesPersons > maxRecords) maxRecords = header.numSalesPersons;
+    if (header.numCustomers > maxRecords) maxRecords = header.numCustomers;
+    TreeEntry* entries = allocTreeEntries(maxRecords);
+    size_t count = 0;
+    for (CarNode* current = carList; current; current = current->next, count++) {
+        entries[count].key = makeStringKey(current->car.VIN);
+        entries[count].seq = count;
+    }
+    offset = writeSnapshotOrder(file, &header, ORDER_CAR_VIN, entries, count, offset);
+    
+    count = 0;
+    size_t position = 0;
+    for (CarNode* current = carList; current; current = current->next, position++) {
+        if (boughtOnLoan(&current->car)) {
+            entries[count].key = loanEmiKey(current);
+            entries[count].seq = position;
+            count++;
         }
     }
-    fclose(file);
+    offset = writeSnapshotOrder(file, &header, ORDER_LOAN_EMI, entries, count, offset);
     
-    // Check sales data file
-    file = fopen(SALES_DATA_FILE, "r");
-    if (!file) {
-        file = fopen(SALES_DATA_FILE, "w");
-        if (!file) {
-            fprintf(stderr, "Failed to create sales data file\n");
-            exit(1);
+    count = 0;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next, count++) {
+        entries[count].key = makeStringKey(current->salesPerson.id);
+        entries[count].seq = count;
+    }
+    offset = writeSnapshotOrder(file, &header, ORDER_SALESPERSON_ID, entries, count, offset);
+    
+    count = 0;
+    for (SalesPersonNode* current = salesPersonList; current; current = current->next, count++) {
+        entries[count].key = salesPersonAchievedKey(current);
+        entries[count].seq = count;
+    }
+    offset = writeSnapshotOrder(file, &header, ORDER_SALESPERSON_ACHIEVED, entries, count, offset);
+    
+    count = 0;
+    for (CustomerNode* current = customerList; current; current = current->next, count++) {
+        entries[count].key = makeStringKey(current->customer.id);
+        entries[count].seq = count;
+    }
+    offset = writeSnapshotOrder(file, &header, ORDER_CUSTOMER_ID, entries, count, offset);
+    free(entries);
+    
+    offset = alignSnapshotOffset(file, offset);
+    header.dictionaryOffset = offset;
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        header.dictionaryCounts[i] = carDictionaries[i].count;
+        for (size_t code = 0; code < carDictionaries[i].count; code++) {
+            size_t length = strlen(carDictionaries[i].values[code]) + 1;
+            fwrite(carDictionaries[i].values[code], 1, length, file);
+            header.dictionarySize += length;
+        }
+    }
+    offset += header.dictionarySize;
+    header.fileSize = offset;
+    
+    rewind(file);
+    fwrite(&header, sizeof(header), 1, file);
+    return finishCompactionFile(file, tempName, fileName);
+}
+
+static bool validSnapshotSection(const SnapshotHeader* header, uint64_t offset, uint64_t count, uint32_t recordSize) {
+    return offset % SNAPSHOT_ALIGNMENT == 0 && 
+           offset <= header->fileSize && 
+           count <= (header->fileSize - offset) / recordSize;
+}
+
+// Re-intern the dictionary strings in code order so every code maps to the same value
+static bool loadSnapshotDictionaries(const SnapshotHeader* header, const char* base) {
+    const char* current = base + header->dictionaryOffset;
+    const char* end = current + header->dictionarySize;
+    for (int i = 0; i < NUM_CAR_DICTIONARIES; i++) {
+        for (uint64_t code = 0; code < header->dictionaryCounts[i]; code++) {
+            const char* terminator = (const char*)memchr(current, '\0', end - current);
+            if (!terminator || code >= MAX_DICTIONARY_CODES || 
+                dictionaryIntern(&carDictionaries[i], current) != code) {
+                return false;
+            }
+            current = terminator + 1;
+        }
+    }
+    return true;
+}
+
+static bool validSnapshotCars(const SnapshotHeader* header, const char* base) {
+    const CarNode* cars = (const CarNode*)(base + header->carOffset);
+    for (uint64_t i = 0; i < header->numCars; i++) {
+        if (cars[i].car.saleIndex > header->numSales) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validSnapshotPurchases(const SnapshotHeader* header, const char* base) {
+    const CustomerNode* customers = (const CustomerNode*)(base + header->customerOffset);
+    for (uint64_t i = 0; i < header->numCustomers; i++) {
+        if (customers[i].customer.firstPurchase > header->numPurchases || 
+            customers[i].customer.lastPurchase > header->numPurchases) {
+            return false;
+        }
+    }
+    const Purchase* records = (const Purchase*)(base + header->purchaseOffset);
+    for (uint64_t i = 0; i < header->numPurchases; i++) {
+        if (records[i].next > header->numPurchases) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool validSnapshotOrders(const SnapshotHeader* header, const char* base) {
+    const uint64_t numRecords[NUM_INDEX_ORDERS] = {
+        header->numCars, header->numSalesPersons, header->numSalesPersons, header->numCustomers, header->numCars
+    };
+    for (int order = 0; order < NUM_INDEX_ORDERS; order++) {
+        if (!validSnapshotSection(header, header->orderOffsets[order], header->orderCounts[order], sizeof(uint32_t)) || 
+            (order == ORDER_LOAN_EMI ? header->orderCounts[order] > numRecords[order] : 
+                                       header->orderCounts[order] != numRecords[order])) {
+            return false;
+        }
+        const uint32_t* positions = (const uint32_t*)(base + header->orderOffsets[order]);
+        for (uint64_t i = 0; i < header->orderCounts[order]; i++) {
+            if (positions[i] >= numRecords[order]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Aim every record's next pointer at the record after it. Only links that are
+// wrong are written, so a snapshot mapped at SNAPSHOT_BASE_ADDRESS is left untouched.
+static void linkSnapshotRecords(char* records, uint64_t count, size_t recordSize, size_t nextOffset) {
+    for (uint64_t i = 0; i < count; i++) {
+        void* next = i + 1 < count ? records + (i + 1) * recordSize : NULL;
+        void* stored;
+        memcpy(&stored, records + i * recordSize + nextOffset, sizeof(stored));
+        if (stored != next) {
+            memcpy(records + i * recordSize + nextOffset, &next, sizeof(next));
+        }
+    }
+}
+
+bool loadSnapshot(const char* fileName) {
+    int fd = open(fileName, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    metricsAdd(METRIC_FILES_OPENED, 1);
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(SnapshotHeader)) {
+        close(fd);
+        return false;
+    }
+    
+    // Private writable mapping: records are updated in place without touching the file
+    void* mapping = MAP_FAILED;
+#ifdef MAP_FIXED_NOREPLACE
+    mapping = mmap((void*)(uintptr_t)SNAPSHOT_BASE_ADDRESS, st.st_size, PROT_READ | PROT_WRITE, 
+                   MAP_PRIVATE | MAP_FIXED_NOREPLACE, fd, 0);
+#endif
+    if (mapping == MAP_FAILED) {
+        mapping = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    
+    const SnapshotHeader* header = (const SnapshotHeader*)mapping;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->headerSize != sizeof(SnapshotHeader) ||
+        header->showroomRecordSize != sizeof(Showroom) ||
+        header->carRecordSize != sizeof(CarNode) ||
+        header->salesPersonRecordSize != sizeof(SalesPersonNode) ||
+        header->customerRecordSize != sizeof(CustomerNode) ||
+        header->saleRecordSize != sizeof(CarSale) ||
+        header->numDictionaries != NUM_CAR_DICTIONARIES ||
+        header->purchaseRecordSize != sizeof(Purchase) ||
+        header->fileSize != (uint64_t)st.st_size ||
+        !validSnapshotSection(header, header->showroomOffset, header->numShowrooms, sizeof(Showroom)) ||
+        !validSnapshotSection(header, header->carOffset, header->numCars, sizeof(CarNode)) ||
+        !validSnapshotSection(header, header->salesPersonOffset, header->numSalesPersons, sizeof(SalesPersonNode)) ||
+        !validSnapshotSection(header, header->customerOffset, header->numCustomers, sizeof(CustomerNode)) ||
+        !validSnapshotSection(header, header->saleOffset, header->numSales, sizeof(CarSale)) ||
+        !validSnapshotSection(header, header->dictionaryOffset, header->dictionarySize, 1) ||
+        !validSnapshotSection(header, header->purchaseOffset, header->numPurchases, sizeof(Purchase)) ||
+        !validSnapshotCars(header, (const char*)mapping) ||
+        !validSnapshotPurchases(header, (const char*)mapping) ||
+        !validSnapshotOrders(header, (const char*)mapping) ||
+        !loadSnapshotDictionaries(header, (const char*)mapping)) {
+        fprintf(stderr, "Ignoring incompatible snapshot %s\n", fileName);
+        munmap(mapping, st.st_size);
+        return false;
+    }
+    
+    snapshotMapping = mapping;
+    snapshotSize = st.st_size;
+    char* base = (char*)mapping;
+    
+    // Showrooms are few and may be reallocated, so they are copied out
+    numShowrooms = (int)header->numShowrooms;
+    showrooms = (Showroom*)malloc((numShowrooms > 0 ? numShowrooms : 1) * sizeof(Showroom));
+    if (!showrooms) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(showrooms, base + header->showroomOffset, numShowrooms * sizeof(Showroom));
+    initializeShowrooms();
+    
+    // Sale details are used where they are mapped, but for a partly filled last
+    // segment, which is copied out since new sales are appended to it
+    CarSale* sales = (CarSale*)(base + header->saleOffset);
+    size_t mappedSales = header->numSales >> CAR_SALE_SEGMENT_SHIFT << CAR_SALE_SEGMENT_SHIFT;
+    for (size_t i = 0; i < mappedSales; i += 1UL << CAR_SALE_SEGMENT_SHIFT) {
+        carSaleSegments[i >> CAR_SALE_SEGMENT_SHIFT] = sales + i;
+    }
+    carSaleCapacity = mappedSales;
+    reserveCarSales(header->numSales);
+    numCarSales = header->numSales;
+    if (numCarSales > mappedSales) {
+        memcpy(carSaleAt(mappedSales), sales + mappedSales, (numCarSales - mappedSales) * sizeof(CarSale));
+    }
+    
+    // Purchases too, until the first new one moves them out
+    purchasePool.items = header->numPurchases > 0 ? (Purchase*)(base + header->purchaseOffset) : NULL;
+    purchasePool.count = header->numPurchases;
+    purchasePool.capacity = header->numPurchases;
+    
+    // The lists run through the mapped records in file order
+    CarNode* cars = (CarNode*)(base + header->carOffset);
+    linkSnapshotRecords((char*)cars, header->numCars, sizeof(CarNode), offsetof(CarNode, next));
+    carList = header->numCars > 0 ? cars : NULL;
+    
+    SalesPersonNode* salesPersons = (SalesPersonNode*)(base + header->salesPersonOffset);
+    linkSnapshotRecords((char*)salesPersons, header->numSalesPersons, sizeof(SalesPersonNode), offsetof(SalesPersonNode, next));
+    salesPersonList = header->numSalesPersons > 0 ? salesPersons : NULL;
+    
+    CustomerNode* customers = (CustomerNode*)(base + header->customerOffset);
+    linkSnapshotRecords((char*)customers, header->numCustomers, sizeof(CustomerNode), offsetof(CustomerNode, next));
+    customerList = header->numCustomers > 0 ? customers : NULL;
+    
+    SnapshotIndexes indexes;
+    indexes.cars = cars;
+    indexes.salesPersons = salesPersons;
+    indexes.customers = customers;
+    for (int i = 0; i < NUM_INDEX_ORDERS; i++) {
+        indexes.orders[i] = (const uint32_t*)(base + header->orderOffsets[i]);
+        indexes.orderCounts[i] = header->orderCounts[i];
+    }
+    buildIndexes(&indexes);
+    
+    return true;
+}
+
+// The text files win when someone has replaced them after the last snapshot
+static bool textFilesNewerThanSnapshot(const struct stat* snapshotStat) {
+    const char* textFiles[] = {
+        CAR_DATA_FILE, SALESPERSON_DATA_FILE, CUSTOMER_DATA_FILE, SHOWROOM_DATA_FILE
+    };
+    
+    for (size_t i = 0; i < sizeof(textFiles) / sizeof(textFiles[0]); i++) {
+        struct stat st;
+        if (stat(textFiles[i], &st) != 0) {
+            continue;
+        }
+        if (st.st_mtim.tv_sec > snapshotStat->st_mtim.tv_sec ||
+            (st.st_mtim.tv_sec == snapshotStat->st_mtim.tv_sec && 
+             st.st_mtim.tv_nsec > snapshotStat->st_mtim.tv_nsec)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void loadDataFromFiles() {
+    uint64_t start = metricsNow();
+    struct stat snapshotStat;
+    if (!(stat(SNAPSHOT_FILE, &snapshotStat) == 0 && 
+          !textFilesNewerThanSnapshot(&snapshotStat) && 
+          loadSnapshot(SNAPSHOT_FILE))) {
+        importTextFiles();
+    }
+    commitSales();
+    recordLatency(METRIC_LOAD, start);
+}
+
+void initializeTrees() {
+    carVinTree = NULL;
+    salesPersonTree = NULL;
+    customerTree = NULL;
+    carSalesTree = NULL;
+    salesPersonAchievedTree = NULL;
+    loanEmiTree = NULL;
+    
+    // Showroom-specific trees will be initialized in loadDataFromFiles
+}
+
+void addCar(FILE* out, Car* car) {
+    // Generate a new VIN if not provided
+    if (strlen(car->VIN) == 0) {
+        char* vin = createNewId("CAR");
+        copyString(car->VIN, sizeof(car->VIN), vin);
+        free(vin);
+    }
+    
+    // Insert into linked list and trees
+    if (!insertCarRecord(car)) {
+        return;
+    }
+    
+    // Save to file
+    saveCarToFile(car);
+    
+    fprintf(out, "Car added with VIN: %s\n", car->VIN);
+}
+
+void addCustomer(FILE* out, Customer* customer) {
+    // Generate a new ID if not provided
+    if (strlen(customer->id) == 0) {
+        char* id = createNewId("CUST");
+        copyString(customer->id, sizeof(customer->id), id);
+        free(id);
+    }
+    
+    // Insert into linked list and tree
+    if (!insertCustomerRecord(customer)) {
+        return;
+    }
+    
+    // Save to file
+    saveCustomerToFile(customer);
+    
+    fprintf(out, "Customer added with ID: %s\n", customer->id);
+}
+
+void printMostPopularCar(FILE* out) {
+    char* popularCar = findMostPopularCar();
+    fprintf(out, "Most popular car: %s\n", popularCar);
+    free(popularCar);
+}
+
+void printMostSuccessfulSalesPerson(FILE* out) {
+    SalesPerson* bestSP = findMostSuccessfulSalesPerson();
+    if (bestSP) {
+        fprintf(out, "Most successful salesperson: %s (%.2f lakhs)\n", 
+                     bestSP->name, bestSP->achieved);
+        fprintf(out, "Incentive: %.2f lakhs\n", salesPersonIncentive(bestSP));
+    } else {
+        fprintf(out, "No salespeople found in the system\n");
+    }
+}
+
+// Script mode
+// Runs the menu operations from a file (or stdin) without prompts. Each line
+// is a command name followed by its comma-separated fields, in the order the
+// menu asks for them; empty lines and // comment lines are skipped. Output
+// goes through one large stdout buffer instead of a flush per prompt.
+static void scriptAddCar(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    if (args[0].length > KEY_BYTES) {
+        fprintf(out, "VIN must be at most %d characters\n", KEY_BYTES);
+        return;
+    }
+    
+    Car newCar;
+    memset(&newCar, 0, sizeof(Car));
+    newCar.available = true;
+    copyField(newCar.VIN, sizeof(newCar.VIN), args[0]);
+    newCar.name = internCarField(carDictionaries, DICT_MODEL, args[1]);
+    newCar.color = internCarField(carDictionaries, DICT_COLOR, args[2]);
+    newCar.price = parseFieldDouble(args[3]);
+    newCar.fuelType = internCarField(carDictionaries, DICT_FUEL_TYPE, args[4]);
+    newCar.bodyType = internCarField(carDictionaries, DICT_BODY_TYPE, args[5]);
+    newCar.showroomId = internCarField(carDictionaries, DICT_SHOWROOM, args[6]);
+    addCar(out, &newCar);
+}
+
+static void scriptAddSalesPerson(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    SalesPerson newSP;
+    memset(&newSP, 0, sizeof(SalesPerson));
+    copyField(newSP.id, sizeof(newSP.id), args[0]);
+    copyField(newSP.name, sizeof(newSP.name), args[1]);
+    copyField(newSP.showroomId, sizeof(newSP.showroomId), args[2]);
+    newSP.target = parseFieldDouble(args[3]);
+    addNewSalesPerson(out, &newSP);
+}
+
+static void scriptAddCustomer(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    if (args[0].length > KEY_BYTES) {
+        fprintf(out, "Customer ID must be at most %d characters\n", KEY_BYTES);
+        return;
+    }
+    
+    Customer newCustomer;
+    memset(&newCustomer, 0, sizeof(Customer));
+    copyField(newCustomer.id, sizeof(newCustomer.id), args[0]);
+    copyField(newCustomer.name, sizeof(newCustomer.name), args[1]);
+    copyField(newCustomer.mobileNo, sizeof(newCustomer.mobileNo), args[2]);
+    copyField(newCustomer.address, sizeof(newCustomer.address), args[3]);
+    addCustomer(out, &newCustomer);
+}
+
+static void scriptSell(FILE* out, const FieldView* args, size_t numArgs) {
+    SaleRequest request;
+    if (!parseSaleRequest(args, numArgs, &request)) {
+        fprintf(out, "A VIN is required to sell a car\n");
+        return;
+    }
+    if (strcmp(request.paymentType, "Loan") != 0) {
+        request.emiMonths = 0;
+        request.downPayment = 0;
+    }
+    sellCarToCustomer(out, request.VIN, request.customerId, request.salesPersonId, 
+                           request.paymentType, request.emiMonths, request.downPayment);
+}
+
+static void scriptSellBatch(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char fileName[MAX_STRING];
+    copyField(fileName, sizeof(fileName), args[0]);
+    sellCarsFromFile(out, fileName);
+}
+
+static void scriptDisplayCar(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char VIN[MAX_STRING];
+    copyField(VIN, sizeof(VIN), args[0]);
+    displayCarInfo(out, VIN);
+}
+
+static void scriptPopularCar(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    printMostPopularCar(out);
+}
+
+static void scriptBestSalesPerson(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    printMostSuccessfulSalesPerson(out);
+}
+
+static void scriptTargetRange(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    findSalesPersonByTargetRange(out, parseFieldDouble(args[0]), parseFieldDouble(args[1]));
+}
+
+static void scriptEmiRange(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    listCustomersByEmiRange(out, parseFieldInt(args[0]), parseFieldInt(args[1]));
+}
+
+static void scriptPredictSales(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    predictNextMonthSales(out);
+}
+
+static void scriptMerge(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char outputFileName[MAX_STRING];
+    copyField(outputFileName, sizeof(outputFileName), args[0]);
+    mergeShowrooms(out, outputFileName);
+}
+
+static void scriptCompact(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    compactDataFiles();
+    fprintf(out, "Data files compacted\n");
+}
+
+static void scriptVinPrefix(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char prefix[MAX_STRING];
+    copyField(prefix, sizeof(prefix), args[0]);
+    listCarsByVinPrefix(out, prefix);
+}
+
+static void scriptInventory(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char showroomId[MAX_STRING];
+    copyField(showroomId, sizeof(showroomId), args[0]);
+    listShowroomInventory(out, showroomId);
+}
+
+static void scriptShowroomCars(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char showroomId[MAX_STRING];
+    copyField(showroomId, sizeof(showroomId), args[0]);
+    if (fieldEquals(args[1], "available")) {
+        listShowroomCars(out, showroomId, true);
+    } else if (fieldEquals(args[1], "sold")) {
+        listShowroomCars(out, showroomId, false);
+    } else {
+        fprintf(out, "Invalid car status, use available or sold\n");
+    }
+}
+
+static void scriptDashboard(FILE* out, const FieldView* args, size_t numArgs) {
+    char showroomId[MAX_STRING];
+    copyField(showroomId, sizeof(showroomId), csvField(args, numArgs, 0));
+    printShowroomDashboard(out, showroomId[0] ? showroomId : NULL);
+}
+
+static void scriptCarReport(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    int field = parseFieldInt(args[0]);
+    int topCount = parseFieldInt(args[1]);
+    if (field < GROUP_BY_MODEL || field > GROUP_BY_SHOWROOM || topCount < 1) {
+        fprintf(out, "Invalid report options\n");
+        return;
+    }
+    printCarGroupReport(out, (CarGroupField)field, (size_t)topCount);
+}
+
+static void scriptLeaderboard(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char showroomId[MAX_STRING];
+    copyField(showroomId, sizeof(showroomId), args[0]);
+    int topCount = parseFieldInt(args[1]);
+    if (topCount < 1) {
+        fprintf(out, "Invalid number of entries\n");
+        return;
+    }
+    printSalesLeaderboard(out, showroomId[0] ? showroomId : NULL, (size_t)topCount);
+}
+
+static void scriptCustomerCars(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)numArgs;
+    char customerId[MAX_STRING];
+    copyField(customerId, sizeof(customerId), args[0]);
+    listCustomerCars(out, customerId);
+}
+
+static void scriptPoolStats(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    printPoolStats(out);
+}
+
+static void scriptMetrics(FILE* out, const FieldView* args, size_t numArgs) {
+    (void)args;
+    (void)numArgs;
+    printMetrics(out);
+}
+
+static const ScriptCommand scriptCommands[] = {
+    { "ADD_CAR", "VIN,name,color,price,fuelType,bodyType,showroomId", 7, scriptAddCar, ACCESS_WRITE },
+    { "ADD_SALESPERSON", "id,name,showroomId,target", 4, scriptAddSalesPerson, ACCESS_WRITE },
+    { "ADD_CUSTOMER", "id,name,mobileNo,address", 4, scriptAddCustomer, ACCESS_WRITE },
+    { "SELL", "VIN,customerId,salespersonId,paymentType,emiMonths,downPayment", 6, scriptSell, ACCESS_SALE },
+    { "SELL_BATCH", "fileName", 1, scriptSellBatch, ACCESS_SALE },
+    { "DISPLAY_CAR", "VIN", 1, scriptDisplayCar, ACCESS_READ },
+    { "POPULAR_CAR", "", 0, scriptPopularCar, ACCESS_SNAPSHOT },
+    { "BEST_SALESPERSON", "", 0, scriptBestSalesPerson, ACCESS_READ },
+    { "TARGET_RANGE", "minSales,maxSales", 2, scriptTargetRange, ACCESS_READ },
+    { "EMI_RANGE", "minMonths,maxMonths", 2, scriptEmiRange, ACCESS_SNAPSHOT },
+    { "PREDICT_SALES", "", 0, scriptPredictSales, ACCESS_SNAPSHOT },
+    { "MERGE", "outputFileName", 1, scriptMerge, ACCESS_SNAPSHOT },
+    { "COMPACT", "", 0, scriptCompact, ACCESS_WRITE },
+    { "VIN_PREFIX", "prefix", 1, scriptVinPrefix, ACCESS_READ },
+    { "INVENTORY", "showroomId", 1, scriptInventory, ACCESS_READ },
+    { "SHOWROOM_CARS", "showroomId,available|sold", 2, scriptShowroomCars, ACCESS_READ },
+    { "DASHBOARD", "showroomId", 0, scriptDashboard, ACCESS_READ },
+    { "CAR_REPORT", "field,count", 2, scriptCarReport, ACCESS_SNAPSHOT },
+    { "LEADERBOARD", "showroomId,count", 2, scriptLeaderboard, ACCESS_READ },
+    { "CUSTOMER_CARS", "customerId", 1, scriptCustomerCars, ACCESS_READ },
+    { "POOL_STATS", "", 0, scriptPoolStats, ACCESS_READ },
+    { "METRICS", "", 0, scriptMetrics, ACCESS_READ },
+};
+
+static const ScriptCommand* findScriptCommand(FieldView name) {
+    for (size_t i = 0; i < sizeof(scriptCommands) / sizeof(scriptCommands[0]); i++) {
+        if (fieldEquals(name, scriptCommands[i].name)) {
+            return &scriptCommands[i];
         }
     }
-    fclose(file);
+    return NULL;
+}
+
+// A pipe cannot be mapped, so a script on stdin is read into memory first
+static char* readStream(FILE* stream, size_t* size) {
+    size_t capacity = 64 * 1024;
+    char* data = (char*)malloc(capacity);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
     
-    // Check showroom data file
-    file = fopen(SHOWROOM_DATA_FILE, "r");
-    if (!file) {
-        file = fopen(SHOWROOM_DATA_FILE, "w");
-        if (!file) {
-            fprintf(stderr, "Failed to create showroom data file\n");
-            exit(1);
+    *size = 0;
+    size_t read;
+    while ((read = fread(data + *size, 1, capacity - *size, stream)) > 0) {
+        *size += read;
+        if (*size == capacity) {
+            capacity *= 2;
+            char* grown = (char*)realloc(data, capacity);
+            if (!grown) {
+                fprintf(stderr, "Memory allocation failed\n");
+                exit(1);
+            }
+            data = grown;
         }
-        
-        // Create a default showroom if file was just created
-        fprintf(file, "SHW1,Main Showroom,Default\n");
     }
-    fclose(file);
+    return data;
 }
 
-// File operations
-void saveCarToFile(Car* car) {
-    FILE* file = fopen(CAR_DATA_FILE, "a");
-    if (!file) {
-        fprintf(stderr, "Failed to open car data file\n");
-        return;
+// Run every command of the script ("-" for stdin). Returns the number of
+// lines that could not be run.
+size_t runScript(const char* fileName) {
+    CsvReader reader;
+    char* input = NULL;
+    if (strcmp(fileName, "-") == 0) {
+        size_t size;
+        input = readStream(stdin, &size);
+        csvOpenBuffer(&reader, input, size);
+        fileName = "stdin";
+    } else if (!csvOpen(&reader, fileName)) {
+        fprintf(stderr, "Failed to open script file: %s\n", fileName);
+        return 1;
     }
     
-    fprintf(file, "%s,%s,%s,%.2f,%s,%s,%s,%d", 
-            car->VIN, car->name, car->color, car->price, 
-            car->fuelType, car->bodyType, car->showroomId, car->available);
-    
-    if (!car->available) {
-        fprintf(file, ",%s,%s,%s", car->customerId, car->salesPersonId, car->paymentType);
-        if (strcmp(car->paymentType, "Loan") == 0) {
-            fprintf(file, ",%d,%.2f,%.2f", car->emiMonths, car->downPayment, car->emiRate);
+    size_t numErrors = 0;
+    size_t lineNumber = 0;
+    while (csvNextRow(&reader)) {
+        lineNumber++;
+        FieldView name = reader.fields[0];
+        if (!validRowKey(name)) {
+            continue;
+        }
+        
+        const ScriptCommand* command = findScriptCommand(name);
+        size_t numArgs = reader.numFields - 1;
+        if (!command) {
+            fprintf(stderr, "%s:%zu: unknown command %.*s\n", fileName, lineNumber, (int)name.length, name.start);
+            numErrors++;
+        } else if (numArgs < command->minArgs) {
+            fprintf(stderr, "%s:%zu: usage: %s,%s\n", fileName, lineNumber, command->name, command->usage);
+            numErrors++;
+        } else {
+            command->handler(stdout, reader.fields + 1, numArgs);
         }
+        compactIfDue();
+        metricsTick(false);
     }
     
-    fprintf(file, "\n");
-    fclose(file);
+    csvClose(&reader);
+    free(input);
+    fflush(stdout);
+    return numErrors;
 }
 
-void saveSalesPersonToFile(SalesPerson* salesPerson) {
-    FILE* file = fopen(SALESPERSON_DATA_FILE, "a");
-    if (!file) {
-        fprintf(stderr, "Failed to open salesperson data file\n");
-        return;
+// Server mode
+// Serves the script commands to many clients over a Unix domain socket. A
+// request is one command line; its response is the command's output followed
+// by an END line. One thread waits on every connection with epoll and hands
+// clients with input to a pool of workers, so a client is served by one worker
+// at a time and requests on a connection run in order. Commands that only
+// read the store run in parallel and sales run alone. Reports on a sale
+// snapshot, or on what sales never change, hold only the structure lock, so
+// sales go on while they run; adds and compaction hold both locks, structure
+// lock first.
+// Each lock has a gate that a writer holds while it waits, so a steady stream
+// of readers cannot keep it out. The gates are separate, so a sale waiting
+// for the store lock does not hold up snapshot reports.
+static pthread_rwlock_t structureLock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_rwlock_t storeLock = PTHREAD_RWLOCK_INITIALIZER;
+static pthread_mutex_t structureWriterGate = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t storeWriterGate = PTHREAD_MUTEX_INITIALIZER;
+static volatile sig_atomic_t serverStopRequested = 0;
+
+static void lockThroughGate(pthread_rwlock_t* lock, pthread_mutex_t* gate, bool write) {
+    pthread_mutex_lock(gate);
+    if (write) {
+        pthread_rwlock_wrlock(lock);
+    } else {
+        pthread_rwlock_rdlock(lock);
     }
-    
-    fprintf(file, "%s,%s,%s,%.2f,%.2f,%.2f\n", 
-            salesPerson->id, salesPerson->name, salesPerson->showroomId, 
-            salesPerson->target, salesPerson->achieved, salesPerson->commission);
-    
-    fclose(file);
+    pthread_mutex_unlock(gate);
 }
 
-void saveCustomerToFile(Customer* customer) {
-    FILE* file = fopen(CUSTOMER_DATA_FILE, "a");
-    if (!file) {
-        fprintf(stderr, "Failed to open customer data file\n");
-        return;
+static void lockStore(CommandAccess access) {
+    if (access == ACCESS_SNAPSHOT || access == ACCESS_WRITE) {
+        lockThroughGate(&structureLock, &structureWriterGate, access == ACCESS_WRITE);
     }
-    
-    fprintf(file, "%s,%s,%s,%s", 
-            customer->id, customer->name, customer->mobileNo, customer->address);
-    
-    if (customer->numPurchasedCars > 0) {
-        fprintf(file, ",%d", customer->numPurchasedCars);
-        for (int i = 0; i < customer->numPurchasedCars; i++) {
-            fprintf(file, ",%s", customer->purchasedCars[i]);
-        }
+    if (access != ACCESS_SNAPSHOT) {
+        lockThroughGate(&storeLock, &storeWriterGate, access != ACCESS_READ);
     }
-    
-    fprintf(file, "\n");
-    fclose(file);
 }
 
-// Required functions from problem statement
-void mergeShowrooms(const char* outputFileName) {
-    // Define the three input showroom files
-    const char* inputFiles[] = {
-        "showroom1.dat",
-        "showroom2.dat",
-        "showroom3.dat"
-    };
-    const int numInputFiles = 3;
-
-    // Open all input files
-    FILE* inputFilePtrs[3];
-    for (int i = 0; i < numInputFiles; i++) {
-        inputFilePtrs[i] = fopen(inputFiles[i], "r");
-        if (!inputFilePtrs[i]) {
-            fprintf(stderr, "Failed to open input file: %s\n", inputFiles[i]);
-            // Close any files that were successfully opened
-            for (int j = 0; j < i; j++) {
-                fclose(inputFilePtrs[j]);
-            }
-            return;
-        }
+static void unlockStore(CommandAccess access) {
+    if (access != ACCESS_SNAPSHOT) {
+        pthread_rwlock_unlock(&storeLock);
     }
+    if (access == ACCESS_SNAPSHOT || access == ACCESS_WRITE) {
+        pthread_rwlock_unlock(&structureLock);
+    }
+}
 
-    // Open the output file
-    FILE* outputFile = fopen(outputFileName, "w");
-    if (!outputFile) {
-        fprintf(stderr, "Failed to create output file\n");
-        for (int i = 0; i < numInputFiles; i++) {
-            fclose(inputFilePtrs[i]);
-        }
+static void requestServerStop(int signal) {
+    (void)signal;
+    serverStopRequested = 1;
+}
+
+static void runServerRequest(FILE* out, const FieldView* fields, size_t numFields) {
+    FieldView name = fields[0];
+    if (!validRowKey(name)) {
         return;
     }
+    
+    const ScriptCommand* command = findScriptCommand(name);
+    size_t numArgs = numFields - 1;
+    if (!command) {
+        fprintf(out, "ERROR unknown command %.*s\n", (int)name.length, name.start);
+    } else if (numArgs < command->minArgs) {
+        fprintf(out, "ERROR usage: %s,%s\n", command->name, command->usage);
+    } else {
+        lockStore(command->access);
+        command->handler(out, fields + 1, numArgs);
+        unlockStore(command->access);
+    }
+    fprintf(out, "%s\n", SERVER_RESPONSE_END);
+}
 
-    // Header for the output file
-    fprintf(outputFile, "VIN,CarName,Color,Price,FuelType,BodyType,ShowroomID,Available\n");
-
-    // We'll use a simple merge approach by reading one line from each file
-    // and always writing the smallest VIN to the output file
-    char currentLines[3][1024];
-    char currentVINs[3][MAX_STRING];
-    bool fileFinished[3] = {false};
-    int filesRemaining = numInputFiles;
-
-    // Initialize by reading first line from each file
-    for (int i = 0; i < numInputFiles; i++) {
-        if (fgets(currentLines[i], sizeof(currentLines[i]), inputFilePtrs[i])) {
-            // Remove newline character if present
-            currentLines[i][strcspn(currentLines[i], "\r\n")] = '\0';
-            
-            // Extract VIN from the line (first field)
-            strcpy(currentVINs[i], strtok(currentLines[i], ","));
-        } else {
-            fileFinished[i] = true;
-            filesRemaining--;
+static bool sendAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t sent = send(fd, data, size, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
         }
+        data += sent;
+        size -= sent;
     }
+    return true;
+}
 
-    // Merge process
-    while (filesRemaining > 0) {
-        // Find the file with the smallest current VIN
-        int minIndex = -1;
-        for (int i = 0; i < numInputFiles; i++) {
-            if (!fileFinished[i]) {
-                if (minIndex == -1 || compareStrings(currentVINs[i], currentVINs[minIndex]) < 0) {
-                    minIndex = i;
-                }
-            }
+// Read what the client has sent and answer every complete request in it.
+// Returns false once the connection should be closed.
+static bool serveClient(ServerClient* client) {
+    char buffer[SERVER_READ_BUFFER];
+    ssize_t received = recv(client->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (received < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    if (received == 0) {
+        return false;
+    }
+    
+    if (client->length + received > client->capacity) {
+        size_t capacity = client->capacity ? client->capacity : SERVER_READ_BUFFER;
+        while (capacity < client->length + received) capacity *= 2;
+        char* grown = (char*)realloc(client->pending, capacity);
+        if (!grown) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
         }
-
-        if (minIndex == -1) {
-            break;  // Shouldn't happen if filesRemaining > 0
+        client->pending = grown;
+        client->capacity = capacity;
+    }
+    memcpy(client->pending + client->length, buffer, received);
+    client->length += received;
+    
+    size_t complete = client->length;
+    while (complete > 0 && client->pending[complete - 1] != '\n') {
+        complete--;
+    }
+    if (complete == 0) {
+        if (client->length > SERVER_MAX_REQUEST) {
+            static const char tooLong[] = "ERROR request too long\n" SERVER_RESPONSE_END "\n";
+            sendAll(client->fd, tooLong, sizeof(tooLong) - 1);
+            return false;
         }
+        return true;
+    }
+    
+    // Responses are built in memory so no lock is held while a slow client reads
+    char* response = NULL;
+    size_t responseSize = 0;
+    FILE* out = open_memstream(&response, &responseSize);
+    if (!out) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    CsvReader reader;
+    csvOpenBuffer(&reader, client->pending, complete);
+    while (csvNextRow(&reader)) {
+        runServerRequest(out, reader.fields, reader.numFields);
+    }
+    csvClose(&reader);
+    fclose(out);
+    
+    client->length -= complete;
+    memmove(client->pending, client->pending + complete, client->length);
+    bool sent = sendAll(client->fd, response, responseSize);
+    free(response);
+    return sent;
+}
 
-        // Write the line to output file
-        fprintf(outputFile, "%s\n", currentLines[minIndex]);
+static void disconnectClient(Server* server, ServerClient* client) {
+    pthread_mutex_lock(&server->lock);
+    if (client->prev) {
+        client->prev->next = client->next;
+    } else {
+        server->clients = client->next;
+    }
+    if (client->next) {
+        client->next->prev = client->prev;
+    }
+    pthread_mutex_unlock(&server->lock);
+    
+    close(client->fd);  // Also removes it from the epoll set
+    free(client->pending);
+    free(client);
+}
 
-        // Read next line from this file
-        if (fgets(currentLines[minIndex], sizeof(currentLines[minIndex]), inputFilePtrs[minIndex])) {
-            // Remove newline character if present
-            currentLines[minIndex][strcspn(currentLines[minIndex], "\r\n")] = '\0';
-            
-            // Extract VIN from the new line
-            strcpy(currentVINs[minIndex], strtok(currentLines[minIndex], ","));
+static void* serverWorker(void* arg) {
+    Server* server = (Server*)arg;
+    while (true) {
+        pthread_mutex_lock(&server->lock);
+        while (!server->readyHead && !server->exportPending && !server->stopping) {
+            pthread_cond_wait(&server->hasWork, &server->lock);
+        }
+        if (server->stopping) {
+            pthread_mutex_unlock(&server->lock);
+            return NULL;
+        }
+        if (server->exportPending) {
+            server->exportPending = false;
+            pthread_mutex_unlock(&server->lock);
+            lockStore(ACCESS_READ);
+            metricsTick(false);
+            unlockStore(ACCESS_READ);
+            continue;
+        }
+        ServerClient* client = server->readyHead;
+        server->readyHead = client->nextReady;
+        if (!server->readyHead) {
+            server->readyTail = NULL;
+        }
+        pthread_mutex_unlock(&server->lock);
+        
+        // The client is out of the epoll set until it is armed again, so no
+        // other worker can pick it up meanwhile
+        if (serveClient(client)) {
+            struct epoll_event event;
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.ptr = client;
+            epoll_ctl(server->epollFd, EPOLL_CTL_MOD, client->fd, &event);
         } else {
-            fileFinished[minIndex] = true;
-            filesRemaining--;
+            disconnectClient(server, client);
+        }
+        
+        // A sale that filled the journal has been answered by now. Compaction
+        // only reads the store, so lookups and reports carry on meanwhile.
+        if (__atomic_load_n(&compactionDue, __ATOMIC_RELAXED)) {
+            lockStore(ACCESS_READ);
+            compactIfDue();
+            unlockStore(ACCESS_READ);
         }
     }
+}
 
-    // Close all files
-    for (int i = 0; i < numInputFiles; i++) {
-        fclose(inputFilePtrs[i]);
+static void acceptClients(Server* server) {
+    int fd;
+    while ((fd = accept(server->listenFd, NULL, NULL)) >= 0) {
+        ServerClient* client = (ServerClient*)calloc(1, sizeof(ServerClient));
+        if (!client) {
+            fprintf(stderr, "Memory allocation failed\n");
+            exit(1);
+        }
+        client->fd = fd;
+        
+        pthread_mutex_lock(&server->lock);
+        client->next = server->clients;
+        if (server->clients) {
+            server->clients->prev = client;
+        }
+        server->clients = client;
+        pthread_mutex_unlock(&server->lock);
+        
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLONESHOT;
+        event.data.ptr = client;
+        if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            disconnectClient(server, client);
+        }
     }
-    fclose(outputFile);
-
-    printf("Successfully merged showroom data to %s, sorted by VIN\n", outputFileName);
 }
-void addNewSalesPerson(SalesPerson* salesPerson) {
-    // Create a new sales person node
-    SalesPersonNode* newNode = (SalesPersonNode*)malloc(sizeof(SalesPersonNode));
-    if (!newNode) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return;
+
+static int openServerSocket(const char* socketPath) {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(socketPath) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", socketPath);
+        return -1;
     }
+    strcpy(address.sun_path, socketPath);
     
-    // Generate a new ID if not provided
-    if (strlen(salesPerson->id) == 0) {
-        char* id = createNewId("SP");
-        strcpy(salesPerson->id, id);
-        free(id);
+    // A socket left behind by a server that did not shut down cleanly
+    struct stat st;
+    if (stat(socketPath, &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(socketPath);
     }
     
-    // Copy the sales person data
-    memcpy(&newNode->salesPerson, salesPerson, sizeof(SalesPerson));
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || 
+        listen(fd, SERVER_BACKLOG) != 0 || 
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", socketPath, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Serve until SIGINT or SIGTERM. Returns 0 on a clean shutdown.
+int runServer(const char* socketPath) {
+    Server server;
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    pthread_cond_init(&server.hasWork, NULL);
     
-    // Insert into linked list
-    newNode->next = salesPersonList;
-    salesPersonList = newNode;
+    server.listenFd = openServerSocket(socketPath);
+    if (server.listenFd < 0) {
+        return 1;
+    }
+    server.epollFd = epoll_create1(0);
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = NULL;  // The listening socket
+    if (server.epollFd < 0 || epoll_ctl(server.epollFd, EPOLL_CTL_ADD, server.listenFd, &event) != 0) {
+        perror("epoll");
+        close(server.listenFd);
+        unlink(socketPath);
+        return 1;
+    }
     
-    // Insert into B+ tree
-    insertIntoTree(&salesPersonTree, salesPerson->id, (void*)newNode);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = requestServerStop;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
     
-    // Save to file
-    saveSalesPersonToFile(salesPerson);
+    size_t numWorkers = workerThreadCount();
+    pthread_t workers[MAX_WORKER_THREADS];
+    size_t started = 0;
+    for (size_t i = 0; i < numWorkers; i++) {
+        if (pthread_create(&workers[started], NULL, serverWorker, &server) == 0) {
+            started++;
+        }
+    }
+    fprintf(stderr, "Serving on %s with %zu workers\n", socketPath, started);
     
-    printf("Sales person added with ID: %s\n", salesPerson->id);
-}
-
-char* findMostPopularCar() {
-    // Create a map to count occurrences of each car model
-    struct {
-        char model[MAX_STRING];
-        int count;
-    } modelCounts[1000];  // Assuming max 1000 different models
-    int numModels = 0;
-    
-    // Traverse all cars and count models
-    CarNode* current = carList;
-    while (current) {
-        bool found = false;
-        for (int i = 0; i < numModels; i++) {
-            if (strcmp(modelCounts[i].model, current->car.name) == 0) {
-                modelCounts[i].count++;
-                found = true;
-                break;
-            }
+    struct epoll_event events[SERVER_MAX_EVENTS];
+    uint64_t lastTick = metricsNow();
+    while (!serverStopRequested && started > 0) {
+        int numEvents = epoll_wait(server.epollFd, events, SERVER_MAX_EVENTS, SERVER_TICK_MS);
+        if (numEvents < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            break;
         }
         
-        if (!found && numModels < 1000) {
-            strcpy(modelCounts[numModels].model, current->car.name);
-            modelCounts[numModels].count = 1;
-            numModels++;
+        for (int i = 0; i < numEvents; i++) {
+            ServerClient* client = (ServerClient*)events[i].data.ptr;
+            if (!client) {
+                acceptClients(&server);
+                continue;
+            }
+            pthread_mutex_lock(&server.lock);
+            client->nextReady = NULL;
+            if (server.readyTail) {
+                server.readyTail->nextReady = client;
+            } else {
+                server.readyHead = client;
+            }
+            server.readyTail = client;
+            pthread_cond_signal(&server.hasWork);
+            pthread_mutex_unlock(&server.lock);
         }
         
-        current = current->next;
+        // Metrics measure the trees, so they are exported between writes. That
+        // means waiting for the store lock, which a worker does in our place.
+        if (metricsNow() - lastTick >= SERVER_TICK_MS * 1000000ULL) {
+            if (metricsExportDue()) {
+                pthread_mutex_lock(&server.lock);
+                server.exportPending = true;
+                pthread_cond_signal(&server.hasWork);
+                pthread_mutex_unlock(&server.lock);
+            }
+            lastTick = metricsNow();
+        }
     }
     
-    // Find the most popular model
-    int maxCount = 0;
-    char* mostPopular = (char*)malloc(MAX_STRING);
-    if (!mostPopular) {
-        fprintf(stderr, "Memory allocation failed\n");
-        exit(1);
+    pthread_mutex_lock(&server.lock);
+    server.stopping = true;
+    pthread_cond_broadcast(&server.hasWork);
+    pthread_mutex_unlock(&server.lock);
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(workers[i], NULL);
     }
-    mostPopular[0] = '\0';
     
-    for (int i = 0; i < numModels; i++) {
-        if (modelCounts[i].count > maxCount) {
-            maxCount = modelCounts[i].count;
-            strcpy(mostPopular, modelCounts[i].model);
-        }
+    while (server.clients) {
+        disconnectClient(&server, server.clients);
     }
-    
-    return mostPopular;
+    close(server.epollFd);
+    close(server.listenFd);
+    unlink(socketPath);
+    pthread_cond_destroy(&server.hasWork);
+    pthread_mutex_destroy(&server.lock);
+    fprintf(stderr, "Server stopped\n");
+    return started > 0 ? 0 : 1;
 }
 
-SalesPerson* findMostSuccessfulSalesPerson() {
-    SalesPersonNode* current = salesPersonList;
-    SalesPerson* mostSuccessful = NULL;
-    double maxAchieved = 0;
-    
-    while (current) {
-        if (current->salesPerson.achieved > maxAchieved) {
-            maxAchieved = current->salesPerson.achieved;
-            mostSuccessful = &current->salesPerson;
+// Data generator
+// Writes a synthetic dataset of the requested size to the data files of the
+// current directory, replacing what is there. Model popularity follows a Zipf
+// distribution, so a few models account for most cars. Cars get sequential
+// VINs and each is also written to its showroom's feed, which keeps the feeds
+// sorted by VIN for merging. The same seed always gives the same files.
+static const char* const generatorModels[] = {
+    "Swift", "Creta", "City", "i20", "Nexon", "Innova", "Baleno", "Seltos", "Verna", "XUV700",
+    "Corolla", "Camry", "Civic", "Brezza", "Venue", "Sonet", "Thar", "Scorpio", "Fortuner", "Dzire",
+    "Alto", "WagonR", "Kwid", "Polo", "Virtus", "Octavia", "3 Series", "5 Series", "X5", "A4"
+};
+static const char* const generatorColors[] = {
+    "White", "Black", "Silver", "Grey", "Red", "Blue", "Brown", "Green"
+};
+static const char* const generatorFuelTypes[] = { "Petrol", "Diesel", "CNG", "Electric" };
+static const char* const generatorBodyTypes[] = { "Hatchback", "Sedan", "SUV" };
+static const char* const generatorManufacturers[] = {
+    "Maruti", "Hyundai", "Tata", "Mahindra", "Toyota", "Honda", "Kia", "Skoda"
+};
+static const char* const generatorFirstNames[] = {
+    "Aarav", "Priya", "Rahul", "Ananya", "Vikram", "Sneha", "Arjun", "Kavya", "Rohan", "Meera"
+};
+static const char* const generatorLastNames[] = {
+    "Sharma", "Patel", "Reddy", "Iyer", "Gupta", "Nair", "Singh", "Joshi", "Rao", "Das"
+};
+static const char* const generatorCities[] = {
+    "Mumbai", "Delhi", "Bengaluru", "Chennai", "Pune", "Hyderabad", "Kolkata", "Jaipur"
+};
+static const int generatorEmiMonths[] = { 12, 24, 36, 48, 60, 72, 84 };
+
+#define GENERATOR_PICK(state, values) ((values)[nextRandom(state) % (sizeof(values) / sizeof((values)[0]))])
+
+// splitmix64
+static uint64_t nextRandom(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, 1)
+static double nextRandomUnit(uint64_t* state) {
+    return (nextRandom(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Index of a model drawn from the Zipf cumulative distribution
+static size_t sampleZipf(const double* cumulative, size_t count, uint64_t* state) {
+    double u = nextRandomUnit(state) * cumulative[count - 1];
+    size_t low = 0;
+    size_t high = count - 1;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (cumulative[mid] <= u) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
-        current = current->next;
     }
-    
-    // Calculate incentive for the most successful salesperson
-    if (mostSuccessful) {
-        mostSuccessful->commission += (mostSuccessful->achieved * 0.01); // 1% incentive
+    return low;
+}
+
+static FILE* openGeneratorFile(const char* fileName, size_t bufferSize) {
+    FILE* file = openFile(fileName, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to create %s\n", fileName);
+        return NULL;
     }
-    
-    return mostSuccessful;
+    setvbuf(file, NULL, _IOFBF, bufferSize);
+    return file;
 }
 
-void sellCarToCustomer(const char* VIN, const char* customerId, const char* salesPersonId, const char* paymentType, int emiMonths, double downPayment) {
-    // Find the car
-    CarNode* carNode = (CarNode*)search(carVinTree, VIN);
-    if (!carNode) {
-        printf("Car not found with VIN: %s\n", VIN);
-        return;
+static bool closeGeneratorFile(FILE* file, const char* fileName) {
+    bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed) {
+        fprintf(stderr, "Failed to write %s\n", fileName);
+        return false;
+    }
+    return true;
+}
+
+static void* generatorAlloc(size_t count, size_t size) {
+    void* data = calloc(count > 0 ? count : 1, size);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return data;
+}
+
+bool generateDataset(const DatasetSize* size) {
+    if (size->cars > GENERATOR_MAX_CARS || size->customers == 0 || size->salesPersons == 0 || 
+        size->showrooms == 0 || size->showrooms > GENERATOR_MAX_SHOWROOMS) {
+        fprintf(stderr, "Dataset size out of range: up to %d cars, at least one customer and salesperson, 1 to %d showrooms\n", 
+                GENERATOR_MAX_CARS, GENERATOR_MAX_SHOWROOMS);
+        return false;
     }
     
-    if (!carNode->car.available) {
-        printf("Car with VIN %s is already sold\n", VIN);
-        return;
+    uint64_t state = GENERATOR_SEED;
+    size_t numModels = sizeof(generatorModels) / sizeof(generatorModels[0]);
+    double cumulative[sizeof(generatorModels) / sizeof(generatorModels[0])];
+    double modelPrices[sizeof(generatorModels) / sizeof(generatorModels[0])];
+    double total = 0;
+    for (size_t i = 0; i < numModels; i++) {
+        total += 1.0 / pow((double)(i + 1), GENERATOR_ZIPF_EXPONENT);
+        cumulative[i] = total;
+        modelPrices[i] = 400000.0 + (double)(nextRandom(&state) % 56) * 100000.0;
     }
     
-    // Find the customer
-    CustomerNode* customerNode = (CustomerNode*)search(customerTree, customerId);
-    if (!customerNode) {
-        printf("Customer not found with ID: %s\n", customerId);
-        return;
+    // The journal, snapshot and feeds of the old data would be replayed or merged into the new
+    unlink(JOURNAL_FILE);
+    unlink(SNAPSHOT_FILE);
+    glob_t feeds;
+    if (glob(SHOWROOM_FEED_PATTERN, 0, NULL, &feeds) == 0) {
+        for (size_t i = 0; i < feeds.gl_pathc; i++) {
+            if (strcmp(feeds.gl_pathv[i], SHOWROOM_DATA_FILE) != 0) unlink(feeds.gl_pathv[i]);
+        }
+        globfree(&feeds);
     }
     
-    // Find the sales person
-    SalesPersonNode* salesPersonNode = (SalesPersonNode*)search(salesPersonTree, salesPersonId);
-    if (!salesPersonNode) {
-        printf("Sales person not found with ID: %s\n", salesPersonId);
-        return;
+    // Showrooms
+    FILE* file = openGeneratorFile(SHOWROOM_DATA_FILE, BUFSIZ);
+    if (!file) return false;
+    for (size_t i = 0; i < size->showrooms; i++) {
+        fprintf(file, "SR%03zu,Showroom %zu,%s\n", i + 1, i + 1, GENERATOR_PICK(&state, generatorManufacturers));
     }
+    if (!closeGeneratorFile(file, SHOWROOM_DATA_FILE)) return false;
     
-    // Check if down payment is sufficient for loan
-    if (strcmp(paymentType, "Loan") == 0) {
-        double minDownPayment = (carNode->car.price * MIN_DOWN_PAYMENT_PERCENT) / 100.0;
-        if (downPayment < minDownPayment) {
-            printf("Down payment must be at least %.2f (%.2f%% of price)\n", 
-                   minDownPayment, MIN_DOWN_PAYMENT_PERCENT);
-            return;
-        }
+    // Cars, with the buyer of each sold car remembered for the customer file
+    FILE** feedFiles = (FILE**)generatorAlloc(size->showrooms, sizeof(FILE*));
+    char feedName[MAX_STRING];
+    for (size_t i = 0; i < size->showrooms; i++) {
+        snprintf(feedName, sizeof(feedName), "showroom%zu.dat", i + 1);
+        feedFiles[i] = openGeneratorFile(feedName, GENERATOR_FEED_BUFFER);
+        if (!feedFiles[i]) return false;
     }
     
-    // Update car data
-    carNode->car.available = false;
-    strcpy(carNode->car.customerId, customerId);
-    strcpy(carNode->car.salesPersonId, salesPersonId);
-    strcpy(carNode->car.paymentType, paymentType);
+    uint32_t* buyers = (uint32_t*)generatorAlloc(size->cars, sizeof(uint32_t));
+    size_t* purchaseCounts = (size_t*)generatorAlloc(size->customers + 1, sizeof(size_t));
+    double* achieved = (double*)generatorAlloc(size->salesPersons, sizeof(double));
+    file = openGeneratorFile(CAR_DATA_FILE, GENERATOR_OUTPUT_BUFFER);
+    if (!file) return false;
     
-    if (strcmp(paymentType, "Loan") == 0) {
-        carNode->car.emiMonths = emiMonths;
-        carNode->car.downPayment = downPayment;
+    char line[2 * MAX_STRING];
+    for (size_t i = 0; i < size->cars; i++) {
+        size_t model = sampleZipf(cumulative, numModels, &state);
+        size_t showroom = nextRandom(&state) % size->showrooms;
+        double price = modelPrices[model] * (0.9 + 0.2 * nextRandomUnit(&state));
+        int length = snprintf(line, sizeof(line), "CAR%08zu,%s,%s,%.2f,%s,%s,SR%03zu,", 
+                              i + 1, generatorModels[model], GENERATOR_PICK(&state, generatorColors), price, 
+                              GENERATOR_PICK(&state, generatorFuelTypes), GENERATOR_PICK(&state, generatorBodyTypes), 
+                              showroom + 1);
         
-        // Set EMI rate based on months
-        if (emiMonths <= 36) {
-            carNode->car.emiRate = 8.50;
-        } else if (emiMonths <= 60) {
-            carNode->car.emiRate = 8.75;
+        buyers[i] = UINT32_MAX;
+        if (nextRandom(&state) % 100 < GENERATOR_SOLD_PERCENT) {
+            size_t customer = nextRandom(&state) % size->customers;
+            size_t salesPerson = nextRandom(&state) % size->salesPersons;
+            buyers[i] = (uint32_t)customer;
+            purchaseCounts[customer]++;
+            achieved[salesPerson] += price / 100000.0;
+            
+            if (nextRandom(&state) % 100 < GENERATOR_LOAN_PERCENT) {
+                int emiMonths = GENERATOR_PICK(&state, generatorEmiMonths);
+                double downPayment = price * (MIN_DOWN_PAYMENT_PERCENT + 30.0 * nextRandomUnit(&state)) / 100.0;
+                length += snprintf(line + length, sizeof(line) - length, "0,CUST%zu,SP%zu,Loan,%d,%.2f,%.2f\n", 
+                                   customer + 1, salesPerson + 1, emiMonths, downPayment, emiRateForMonths(emiMonths));
+            } else {
+                length += snprintf(line + length, sizeof(line) - length, "0,CUST%zu,SP%zu,Cash\n", 
+                                   customer + 1, salesPerson + 1);
+            }
         } else {
-            carNode->car.emiRate = 9.00;
+            length += snprintf(line + length, sizeof(line) - length, "1\n");
         }
+        fwrite(line, 1, length, file);
+        fwrite(line, 1, length, feedFiles[showroom]);
     }
     
-    // Update customer data
-    if (customerNode->customer.numPurchasedCars < 10) {
-        strcpy(customerNode->customer.purchasedCars[customerNode->customer.numPurchasedCars], VIN);
-        customerNode->customer.numPurchasedCars++;
+    bool written = closeGeneratorFile(file, CAR_DATA_FILE);
+    for (size_t i = 0; i < size->showrooms; i++) {
+        snprintf(feedName, sizeof(feedName), "showroom%zu.dat", i + 1);
+        written = closeGeneratorFile(feedFiles[i], feedName) && written;
     }
+    free(feedFiles);
     
-    // Update sales person data
-    double carPriceInLakhs = carNode->car.price / 100000.0;  // Convert to lakhs
-    salesPersonNode->salesPerson.achieved += carPriceInLakhs;
-    salesPersonNode->salesPerson.commission = salesPersonNode->salesPerson.achieved * COMMISSION_RATE;
-    
-    // Update files - rewrite all data
-    FILE* carFile = fopen(CAR_DATA_FILE, "w");
-    if (carFile) {
-        CarNode* current = carList;
-        while (current) {
-            fprintf(carFile, "%s,%s,%s,%.2f,%s,%s,%s,%d", 
-                current->car.VIN, current->car.name, current->car.color, current->car.price, 
-                current->car.fuelType, current->car.bodyType, current->car.showroomId, current->car.available);
-            
-            if (!current->car.available) {
-                fprintf(carFile, ",%s,%s,%s", current->car.customerId, current->car.salesPersonId, current->car.paymentType);
-                if (strcmp(current->car.paymentType, "Loan") == 0) {
-                    fprintf(carFile, ",%d,%.2f,%.2f", current->car.emiMonths, current->car.downPayment, current->car.emiRate);
-                }
-            }
-            
-            fprintf(carFile, "\n");
-            current = current->next;
+    // Salespersons, spread evenly over the showrooms
+    file = written ? openGeneratorFile(SALESPERSON_DATA_FILE, GENERATOR_OUTPUT_BUFFER) : NULL;
+    if (file) {
+        for (size_t i = 0; i < size->salesPersons; i++) {
+            fprintf(file, "SP%zu,%s %s,SR%03zu,%.2f,%.2f,%.2f\n", 
+                    i + 1, GENERATOR_PICK(&state, generatorFirstNames), GENERATOR_PICK(&state, generatorLastNames), 
+                    i % size->showrooms + 1, 50.0 + (double)(nextRandom(&state) % 451), 
+                    achieved[i], achieved[i] * COMMISSION_RATE);
         }
-        fclose(carFile);
+        written = closeGeneratorFile(file, SALESPERSON_DATA_FILE);
+    } else {
+        written = false;
     }
     
-    FILE* customerFile = fopen(CUSTOMER_DATA_FILE, "w");
-    if (customerFile) {
-        CustomerNode* current = customerList;
-        while (current) {
-            fprintf(customerFile, "%s,%s,%s,%s", 
-                current->customer.id, current->customer.name, current->customer.mobileNo, current->customer.address);
-            
-            if (current->customer.numPurchasedCars > 0) {
-                fprintf(customerFile, ",%d", current->customer.numPurchasedCars);
-                for (int i = 0; i < current->customer.numPurchasedCars; i++) {
-                    fprintf(customerFile, ",%s", current->customer.purchasedCars[i]);
+    // Customers, each followed by the VINs bought - grouped from the car pass by counting sort
+    size_t* purchaseStart = purchaseCounts;
+    size_t offset = 0;
+    for (size_t i = 0; i <= size->customers; i++) {
+        size_t count = purchaseCounts[i];
+        purchaseStart[i] = offset;
+        offset += count;
+    }
+    uint32_t* purchasedCars = (uint32_t*)generatorAlloc(offset, sizeof(uint32_t));
+    size_t* nextPurchase = (size_t*)generatorAlloc(size->customers, sizeof(size_t));
+    memcpy(nextPurchase, purchaseStart, size->customers * sizeof(size_t));
+    for (size_t i = 0; i < size->cars; i++) {
+        if (buyers[i] != UINT32_MAX) purchasedCars[nextPurchase[buyers[i]]++] = (uint32_t)i;
+    }
+    
+    file = written ? openGeneratorFile(CUSTOMER_DATA_FILE, GENERATOR_OUTPUT_BUFFER) : NULL;
+    if (file) {
+        for (size_t i = 0; i < size->customers; i++) {
+            fprintf(file, "CUST%zu,%s %s,9%09llu,%zu %s Road %s", 
+                    i + 1, GENERATOR_PICK(&state, generatorFirstNames), GENERATOR_PICK(&state, generatorLastNames), 
+                    (unsigned long long)(nextRandom(&state) % 1000000000ULL), 1 + (size_t)(nextRandom(&state) % 999), 
+                    GENERATOR_PICK(&state, generatorLastNames), GENERATOR_PICK(&state, generatorCities));
+            size_t numPurchases = nextPurchase[i] - purchaseStart[i];
+            if (numPurchases > 0) {
+                fprintf(file, ",%zu", numPurchases);
+                for (size_t j = purchaseStart[i]; j < nextPurchase[i]; j++) {
+                    fprintf(file, ",CAR%08u", purchasedCars[j] + 1);
                 }
             }
-            
-            fprintf(customerFile, "\n");
-            current = current->next;
+            fprintf(file, "\n");
         }
-        fclose(customerFile);
+        written = closeGeneratorFile(file, CUSTOMER_DATA_FILE);
+    } else {
+        written = false;
     }
     
-    FILE* salesPersonFile = fopen(SALESPERSON_DATA_FILE, "w");
-    if (salesPersonFile) {
-        SalesPersonNode* current = salesPersonList;
-        while (current) {
-            fprintf(salesPersonFile, "%s,%s,%s,%.2f,%.2f,%.2f\n", 
-                current->salesPerson.id, current->salesPerson.name, current->salesPerson.showroomId, 
-                current->salesPerson.target, current->salesPerson.achieved, current->salesPerson.commission);
-            
-            current = current->next;
-        }
-        fclose(salesPersonFile);
+    free(nextPurchase);
+    free(purchasedCars);
+    free(achieved);
+    free(purchaseCounts);
+    free(buyers);
+    
+    if (written) {
+        printf("Generated %zu cars, %zu customers and %zu salespersons across %zu showrooms\n", 
+               size->cars, size->customers, size->salesPersons, size->showrooms);
+    }
+    return written;
+}
+
+// Benchmarks
+// Times the main operations on the data in the current directory (best made
+// with --generate) and prints one JSON object: per operation the count, total
+// seconds, throughput and p50/p99 latency (the load is a single run, so it has
+// no percentiles). Output of the timed functions is discarded. The sales only
+// change memory - the journal is off, so the dataset is the same every run.
+static double benchSeconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static int compareDoubles(const void* a, const void* b) {
+    double left = *(const double*)a;
+    double right = *(const double*)b;
+    return (left > right) - (left < right);
+}
+
+// Nearest-rank percentile of sorted samples
+static double percentile(const double* sorted, size_t count, double fraction) {
+    if (count == 0) return 0;
+    size_t rank = (size_t)ceil(fraction * count);
+    return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+static void printBenchResult(const char* name, double* latencies, size_t count, bool last) {
+    double seconds = 0;
+    for (size_t i = 0; i < count; i++) {
+        seconds += latencies[i];
     }
+    qsort(latencies, count, sizeof(double), compareDoubles);
     
-    printf("Car with VIN %s sold successfully to customer %s\n", VIN, customerNode->customer.name);
+    printf("    {\"name\": \"%s\", \"operations\": %zu, \"seconds\": %.6f, \"opsPerSecond\": %.1f", 
+           name, count, seconds, seconds > 0 ? count / seconds : 0.0);
+    if (count > 1) {
+        printf(", \"p50Micros\": %.3f, \"p99Micros\": %.3f", 
+               percentile(latencies, count, 0.50) * 1e6, percentile(latencies, count, 0.99) * 1e6);
+    }
+    printf("}%s\n", last ? "" : ",");
 }
 
-void predictNextMonthSales() {
-    // Simple prediction based on previous month sales
-    // In a real implementation, this would use more sophisticated techniques
-    double totalSales = 0;
-    int count = 0;
+// Point stdout at /dev/null, returning the descriptor to restore
+static int silenceStdout() {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int devNull = open("/dev/null", O_WRONLY);
+    if (devNull >= 0) {
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+    return saved;
+}
+
+static void restoreStdout(int saved) {
+    fflush(stdout);
+    if (saved >= 0) {
+        dup2(saved, STDOUT_FILENO);
+        close(saved);
+    }
+}
+
+static double* benchLatencies(size_t count) {
+    double* latencies = (double*)malloc((count > 0 ? count : 1) * sizeof(double));
+    if (!latencies) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
+    return latencies;
+}
+
+void runBenchmarks(size_t lookups) {
+    uint64_t state = GENERATOR_SEED;
+    double* latencies[NUM_BENCHMARKS];
+    size_t counts[NUM_BENCHMARKS];
+    static const char* const names[NUM_BENCHMARKS] = {
+        "loadDataFromFiles", "search", "sellCarToCustomer", "findMostPopularCar", 
+        "listCustomersByEmiRange", "mergeShowrooms"
+    };
+    int saved = silenceStdout();
+    journalDisabled = true;
     
-    SalesPersonNode* current = salesPersonList;
-    while (current) {
-        totalSales += current->salesPerson.achieved;
-        count++;
-        current = current->next;
+    latencies[BENCH_LOAD] = benchLatencies(1);
+    counts[BENCH_LOAD] = 1;
+    double start = benchSeconds();
+    loadDataFromFiles();
+    latencies[BENCH_LOAD][0] = benchSeconds() - start;
+    replayJournal();
+    
+    // Sample records to work on
+    size_t numCars = 0;
+    size_t numAvailable = 0;
+    size_t numCustomers = 0;
+    size_t numSalesPersons = 0;
+    for (CarNode* node = carList; node; node = node->next) {
+        numCars++;
+        if (node->car.available) numAvailable++;
     }
+    for (CustomerNode* node = customerList; node; node = node->next) numCustomers++;
+    for (SalesPersonNode* node = salesPersonList; node; node = node->next) numSalesPersons++;
     
-    if (count > 0) {
-        double avgSales = totalSales / count;
-        printf("Predicted next month sales: %.2f lakhs\n", avgSales * 1.05);  // 5% growth assumption
-    } else {
-        printf("No sales data available for prediction\n");
+    CarNode** cars = (CarNode**)malloc((numCars > 0 ? numCars : 1) * sizeof(CarNode*));
+    CarNode** available = (CarNode**)malloc((numAvailable > 0 ? numAvailable : 1) * sizeof(CarNode*));
+    CustomerNode** customers = (CustomerNode**)malloc((numCustomers > 0 ? numCustomers : 1) * sizeof(CustomerNode*));
+    SalesPersonNode** salesPersons = (SalesPersonNode**)malloc((numSalesPersons > 0 ? numSalesPersons : 1) * sizeof(SalesPersonNode*));
+    if (!cars || !available || !customers || !salesPersons) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
-}
-
-void displayCarInfo(const char* VIN) {
-    CarNode* carNode = (CarNode*)search(carVinTree, VIN);
-    if (!carNode) {
-        printf("Car not found with VIN: %s\n", VIN);
-        return;
+    numCars = numAvailable = numCustomers = numSalesPersons = 0;
+    for (CarNode* node = carList; node; node = node->next) {
+        cars[numCars++] = node;
+        if (node->car.available) available[numAvailable++] = node;
     }
+    for (CustomerNode* node = customerList; node; node = node->next) customers[numCustomers++] = node;
+    for (SalesPersonNode* node = salesPersonList; node; node = node->next) salesPersons[numSalesPersons++] = node;
     
-    printf("\n=================== Car Details ===================\n");
-    printf("VIN: %s\n", carNode->car.VIN);
-    printf("Name: %s\n", carNode->car.name);
-    printf("Color: %s\n", carNode->car.color);
-    printf("Price: %.2f\n", carNode->car.price);
-    printf("Fuel Type: %s\n", carNode->car.fuelType);
-    printf("Body Type: %s\n", carNode->car.bodyType);
-    printf("Showroom ID: %s\n", carNode->car.showroomId);
-    printf("Available: %s\n", carNode->car.available ? "Yes" : "No");
+    // Point lookups of random VINs
+    counts[BENCH_SEARCH] = numCars > 0 ? lookups : 0;
+    latencies[BENCH_SEARCH] = benchLatencies(counts[BENCH_SEARCH]);
+    size_t found = 0;
+    for (size_t i = 0; i < counts[BENCH_SEARCH]; i++) {
+        const char* VIN = cars[nextRandom(&state) % numCars]->car.VIN;
+        start = benchSeconds();
+        found += search(carVinTree, VIN) != NULL;
+        latencies[BENCH_SEARCH][i] = benchSeconds() - start;
+    }
+    if (found != counts[BENCH_SEARCH]) {
+        fprintf(stderr, "Benchmark lookups found %zu of %zu cars\n", found, counts[BENCH_SEARCH]);
+    }
     
-    if (!carNode->car.available) {
-        printf("\n----------------- Sale Details -----------------\n");
-        printf("Customer ID: %s\n", carNode->car.customerId);
-        printf("Sales Person ID: %s\n", carNode->car.salesPersonId);
-        printf("Payment Type: %s\n", carNode->car.paymentType);
+    // Sales of distinct available cars, half of them on loan
+    counts[BENCH_SELL] = (numCustomers > 0 && numSalesPersons > 0) ? 
+                         (numAvailable < BENCH_SALES ? numAvailable : BENCH_SALES) : 0;
+    latencies[BENCH_SELL] = benchLatencies(counts[BENCH_SELL]);
+    for (size_t i = 0; i < counts[BENCH_SELL]; i++) {
+        size_t pick = i + nextRandom(&state) % (numAvailable - i);
+        CarNode* car = available[pick];
+        available[pick] = available[i];
+        bool loan = nextRandom(&state) % 2 == 0;
+        int emiMonths = loan ? GENERATOR_PICK(&state, generatorEmiMonths) : 0;
+        double downPayment = loan ? car->car.price * 0.3 : 0;
         
-        if (strcmp(carNode->car.paymentType, "Loan") == 0) {
-            printf("EMI Months: %d\n", carNode->car.emiMonths);
-            printf("Down Payment: %.2f\n", carNode->car.downPayment);
-            printf("EMI Rate: %.2f%%\n", carNode->car.emiRate);
-            
-            // Calculate EMI amount
-            double principal = carNode->car.price - carNode->car.downPayment;
-            double monthlyRate = carNode->car.emiRate / (12 * 100);
-            double emiAmount = principal * monthlyRate * pow(1 + monthlyRate, carNode->car.emiMonths) / 
-                              (pow(1 + monthlyRate, carNode->car.emiMonths) - 1);
-            
-            printf("Monthly EMI: %.2f\n", emiAmount);
-        }
+        start = benchSeconds();
+        sellCarToCustomer(stdout, car->car.VIN, customers[nextRandom(&state) % numCustomers]->customer.id, 
+                                  salesPersons[nextRandom(&state) % numSalesPersons]->salesPerson.id, 
+                                  loan ? "Loan" : "Cash", emiMonths, downPayment);
+        latencies[BENCH_SELL][i] = benchSeconds() - start;
     }
     
-    printf("==================================================\n");
-}
-
-void findSalesPersonByTargetRange(double minSales, double maxSales) {
-    printf("\n========== Sales Persons in Target Range %.2f - %.2f ==========\n", minSales, maxSales);
-    int count = 0;
+    // Full scans
+    counts[BENCH_POPULAR] = BENCH_SCAN_REPEATS;
+    latencies[BENCH_POPULAR] = benchLatencies(BENCH_SCAN_REPEATS);
+    for (size_t i = 0; i < BENCH_SCAN_REPEATS; i++) {
+        start = benchSeconds();
+        free(findMostPopularCar());
+        latencies[BENCH_POPULAR][i] = benchSeconds() - start;
+    }
     
-    SalesPersonNode* current = salesPersonList;
-    while (current) {
-        if (current->salesPerson.achieved >= minSales && current->salesPerson.achieved <= maxSales) {
-            printf("ID: %s, Name: %s, Achieved: %.2f lakhs\n", 
-                   current->salesPerson.id, current->salesPerson.name, current->salesPerson.achieved);
-            count++;
-        }
-        current = current->next;
+    counts[BENCH_EMI_RANGE] = BENCH_SCAN_REPEATS;
+    latencies[BENCH_EMI_RANGE] = benchLatencies(BENCH_SCAN_REPEATS);
+    for (size_t i = 0; i < BENCH_SCAN_REPEATS; i++) {
+        int minMonths = (int)(nextRandom(&state) % 48);
+        start = benchSeconds();
+        listCustomersByEmiRange(stdout, minMonths, minMonths + 25);
+        latencies[BENCH_EMI_RANGE][i] = benchSeconds() - start;
     }
     
-    if (count == 0) {
-        printf("No sales persons found in the given range\n");
-    } else {
-        printf("Total: %d sales persons\n", count);
+    counts[BENCH_MERGE] = BENCH_MERGE_REPEATS;
+    latencies[BENCH_MERGE] = benchLatencies(BENCH_MERGE_REPEATS);
+    for (size_t i = 0; i < BENCH_MERGE_REPEATS; i++) {
+        start = benchSeconds();
+        mergeShowrooms(stdout, BENCH_MERGE_FILE);
+        latencies[BENCH_MERGE][i] = benchSeconds() - start;
     }
-    printf("========================================================\n");
-}
-
-void listCustomersByEmiRange(int minMonths, int maxMonths) {
-    printf("\n========== Customers with EMI Range %d - %d months ==========\n", minMonths, maxMonths);
-    int count = 0;
+    unlink(BENCH_MERGE_FILE);
     
-    // Find all sold cars with EMI in the given range and their customers
-    CarNode* current = carList;
-    while (current) {
-        if (!current->car.available && 
-            strcmp(current->car.paymentType, "Loan") == 0 &&
-            current->car.emiMonths > minMonths && 
-            current->car.emiMonths < maxMonths) {
-            
-            // Find customer details
-            CustomerNode* custNode = (CustomerNode*)search(customerTree, current->car.customerId);
-            if (custNode) {
-                printf("Customer Name: %s, Car: %s, EMI Months: %d\n", 
-                       custNode->customer.name, current->car.name, current->car.emiMonths);
-                count++;
-            }
-        }
-        current = current->next;
+    restoreStdout(saved);
+    printf("{\n");
+    printf("  \"dataset\": {\"cars\": %zu, \"customers\": %zu, \"salespersons\": %zu, \"showrooms\": %d},\n", 
+           numCars, numCustomers, numSalesPersons, numShowrooms);
+    printf("  \"threads\": %zu,\n", workerThreadCount());
+    printf("  \"benchmarks\": [\n");
+    for (int i = 0; i < NUM_BENCHMARKS; i++) {
+        printBenchResult(names[i], latencies[i], counts[i], i == NUM_BENCHMARKS - 1);
+        free(latencies[i]);
     }
+    printf("  ]\n}\n");
     
-    if (count == 0) {
-        printf("No customers found with EMI in the given range\n");
-    } else {
-        printf("Total: %d customers\n", count);
+    free(salesPersons);
+    free(customers);
+    free(available);
+    free(cars);
+}
+
+// Tree benchmark
+// Times insertIntoTree, search and findLeaf on one tree per key distribution
+// and validates each tree once built. The node size is fixed at compile time,
+// so comparing orders means one build per order:
+//   gcc -O2 -DB_PLUS_TREE_ORDER=32 ... && ./showroom --bench-tree
+static const char* const keyDistributionNames[NUM_KEY_DISTRIBUTIONS] = {
+    "sequential", "random", "prefixHeavy"
+};
+
+static void shuffleIndexes(size_t* indexes, size_t count, uint64_t* state) {
+    for (size_t i = count; i > 1; i--) {
+        size_t j = nextRandom(state) % i;
+        size_t swap = indexes[i - 1];
+        indexes[i - 1] = indexes[j];
+        indexes[j] = swap;
     }
-    printf("=========================================================\n");
 }
 
-void freeMemory() {
-    // Free car list
-    CarNode* currentCar = carList;
-    while (currentCar) {
-        CarNode* temp = currentCar;
-        currentCar = currentCar->next;
-        free(temp);
+// Distinct keys in insertion order. Sequential keys are VINs in ascending
+// order, random keys the same VINs shuffled, and prefix-heavy keys share their
+// first 10 bytes so every comparison is decided by the second key word.
+static void makeBenchKeys(char (*keys)[KEY_BYTES + 1], size_t count, KeyDistribution distribution, uint64_t* state) {
+    size_t* order = (size_t*)malloc((count > 0 ? count : 1) * sizeof(size_t));
+    if (!order) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
     }
-    
-    // Free sales person list
-    SalesPersonNode* currentSP = salesPersonList;
-    while (currentSP) {
-        SalesPersonNode* temp = currentSP;
-        currentSP = currentSP->next;
-        free(temp);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
     }
-    
-    // Free customer list
-    CustomerNode* currentCust = customerList;
-    while (currentCust) {
-        CustomerNode* temp = currentCust;
-        currentCust = currentCust->next;
-        free(temp);
+    if (distribution != KEYS_SEQUENTIAL) {
+        shuffleIndexes(order, count, state);
     }
     
-    // Free showrooms array
-    if (showrooms) {
-        free(showrooms);
+    static const char digits[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    for (size_t i = 0; i < count; i++) {
+        if (distribution == KEYS_PREFIX_HEAVY) {
+            char suffix[7];
+            size_t value = order[i];
+            for (int d = 5; d >= 0; d--) {
+                suffix[d] = digits[value % 36];
+                value /= 36;
+            }
+            suffix[6] = '\0';
+            snprintf(keys[i], KEY_BYTES + 1, "SR001-CUST%s", suffix);
+        } else {
+            snprintf(keys[i], KEY_BYTES + 1, "CAR%08zu", order[i] + 1);
+        }
     }
-    
-    // Free B+ Trees (recursive helper function would be needed here)
-    // This is a simplified version - a complete implementation would
-    // recursively free all nodes in the trees
+    free(order);
 }
 
-void loadDataFromFiles() {
-    FILE* file;
-    char line[1024];
+int runTreeBenchmark(size_t numKeys) {
+    uint64_t state = GENERATOR_SEED;
+    char (*keys)[KEY_BYTES + 1] = (char (*)[KEY_BYTES + 1])malloc((numKeys > 0 ? numKeys : 1) * (KEY_BYTES + 1));
+    size_t* lookups = (size_t*)malloc((numKeys > 0 ? numKeys : 1) * sizeof(size_t));
+    if (!keys || !lookups) {
+        fprintf(stderr, "Memory allocation failed\n");
+        exit(1);
+    }
     
-    // Load showrooms
-    file = fopen(SHOWROOM_DATA_FILE, "r");
-    if (file) {
-        // Count showrooms first
-        numShowrooms = 0;
-        while (fgets(line, sizeof(line), file)) {
-            numShowrooms++;
+    bool allValid = true;
+    printf("{\n");
+    printf("  \"order\": %d, \"nodeBytes\": %zu, \"keys\": %zu,\n", 
+           B_PLUS_TREE_ORDER, sizeof(BPlusTreeNode), numKeys);
+    printf("  \"runs\": [\n");
+    for (int d = 0; d < NUM_KEY_DISTRIBUTIONS; d++) {
+        makeBenchKeys(keys, numKeys, (KeyDistribution)d, &state);
+        for (size_t i = 0; i < numKeys; i++) {
+            lookups[i] = i;
         }
+        shuffleIndexes(lookups, numKeys, &state);
         
-        // Allocate memory for showrooms
-        showrooms = (Showroom*)malloc(numShowrooms * sizeof(Showroom));
-        if (!showrooms) {
-            fprintf(stderr, "Memory allocation failed\n");
-            fclose(file);
-            return;
+        // Each key maps to its position so lookups can be checked
+        BPlusTreeNode* root = NULL;
+        double start = benchSeconds();
+        for (size_t i = 0; i < numKeys; i++) {
+            insertIntoTree(&root, keys[i], (void*)(uintptr_t)(i + 1));
         }
+        double insertSeconds = benchSeconds() - start;
         
-        // Reset file pointer and read data
-        rewind(file);
-        int idx = 0;
-        while (fgets(line, sizeof(line), file) && idx < numShowrooms) {
-            line[strcspn(line, "\r\n")] = 0;  // Remove newline
-            
-            char* token = strtok(line, ",");
-            if (token) strcpy(showrooms[idx].id, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(showrooms[idx].name, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(showrooms[idx].manufacturer, token);
-            
-            idx++;
+        size_t found = 0;
+        start = benchSeconds();
+        for (size_t i = 0; i < numKeys; i++) {
+            found += search(root, keys[lookups[i]]) == (void*)(uintptr_t)(lookups[i] + 1);
         }
-        fclose(file);
+        double searchSeconds = benchSeconds() - start;
         
-        // Initialize showroom-specific car trees
-        showroomCarTrees = (BPlusTreeNode**)malloc(numShowrooms * sizeof(BPlusTreeNode*));
-        if (showroomCarTrees) {
-            for (int i = 0; i < numShowrooms; i++) {
-                showroomCarTrees[i] = NULL;
-            }
+        size_t leavesFound = 0;
+        start = benchSeconds();
+        for (size_t i = 0; i < numKeys; i++) {
+            leavesFound += findLeaf(root, keys[lookups[i]]) != NULL;
         }
-    }
-    
-    // Load cars
-    file = fopen(CAR_DATA_FILE, "r");
-    if (file) {
-        while (fgets(line, sizeof(line), file)) {
-            line[strcspn(line, "\r\n")] = 0;  // Remove newline
-            
-            Car car;
-            memset(&car, 0, sizeof(Car));
-            
-            char* token = strtok(line, ",");
-            if (token) strcpy(car.VIN, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(car.name, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(car.color, token);
-            
-            token = strtok(NULL, ",");
-            if (token) car.price = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(car.fuelType, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(car.bodyType, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(car.showroomId, token);
-            
-            token = strtok(NULL, ",");
-            if (token) car.available = atoi(token);
-            
-            if (!car.available) {
-                token = strtok(NULL, ",");
-                if (token) strcpy(car.customerId, token);
-                
-                token = strtok(NULL, ",");
-                if (token) strcpy(car.salesPersonId, token);
-                
-                token = strtok(NULL, ",");
-                if (token) strcpy(car.paymentType, token);
-                
-                if (strcmp(car.paymentType, "Loan") == 0) {
-                    token = strtok(NULL, ",");
-                    if (token) car.emiMonths = atoi(token);
-                    
-                    token = strtok(NULL, ",");
-                    if (token) car.downPayment = atof(token);
-                    
-                    token = strtok(NULL, ",");
-                    if (token) car.emiRate = atof(token);
-                }
-            }
-            
-            // Add car to list and tree
-            CarNode* newNode = (CarNode*)malloc(sizeof(CarNode));
-            if (newNode) {
-                memcpy(&newNode->car, &car, sizeof(Car));
-                newNode->next = carList;
-                carList = newNode;
-                
-                // Add to main car tree
-                insertIntoTree(&carVinTree, car.VIN, (void*)newNode);
-                
-                // Add to showroom-specific tree
-                for (int i = 0; i < numShowrooms; i++) {
-                    if (strcmp(showrooms[i].id, car.showroomId) == 0) {
-                        insertIntoTree(&showroomCarTrees[i], car.VIN, (void*)newNode);
-                        break;
-                    }
-                }
-            }
+        double findLeafSeconds = benchSeconds() - start;
+        
+        TreeStats stats;
+        bool valid = validateTree(root, &stats);
+        if (valid && stats.numKeys != numKeys) {
+            fprintf(stderr, "Invalid tree: %zu of %zu keys in the leaves\n", stats.numKeys, numKeys);
+            valid = false;
         }
-        fclose(file);
-    }
-    
-    // Load salespeople
-    file = fopen(SALESPERSON_DATA_FILE, "r");
-    if (file) {
-        while (fgets(line, sizeof(line), file)) {
-            line[strcspn(line, "\r\n")] = 0;  // Remove newline
-            
-            SalesPerson sp;
-            memset(&sp, 0, sizeof(SalesPerson));
-            
-            char* token = strtok(line, ",");
-            if (token) strcpy(sp.id, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(sp.name, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(sp.showroomId, token);
-            
-            token = strtok(NULL, ",");
-            if (token) sp.target = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token) sp.achieved = atof(token);
-            
-            token = strtok(NULL, ",");
-            if (token) sp.commission = atof(token);
-            
-            // Add salesperson to list and tree
-            SalesPersonNode* newNode = (SalesPersonNode*)malloc(sizeof(SalesPersonNode));
-            if (newNode) {
-                memcpy(&newNode->salesPerson, &sp, sizeof(SalesPerson));
-                newNode->next = salesPersonList;
-                salesPersonList = newNode;
-                
-                insertIntoTree(&salesPersonTree, sp.id, (void*)newNode);
-            }
+        if (valid && (found != numKeys || leavesFound != numKeys)) {
+            fprintf(stderr, "Invalid tree: %zu of %zu keys found with their values\n", found, numKeys);
+            valid = false;
         }
-        fclose(file);
+        allValid = allValid && valid;
+        
+        double perOp = numKeys > 0 ? 1e9 / numKeys : 0;
+        printf("    {\"distribution\": \"%s\", \"insertNs\": %.1f, \"searchNs\": %.1f, \"findLeafNs\": %.1f, "
+               "\"height\": %zu, \"nodes\": %zu, \"leaves\": %zu, \"fillFactor\": %.3f, \"bytesPerKey\": %.1f, "
+               "\"valid\": %s}%s\n", 
+               keyDistributionNames[d], insertSeconds * perOp, searchSeconds * perOp, findLeafSeconds * perOp, 
+               stats.height, stats.numNodes, stats.numLeaves, 
+               stats.numLeaves > 0 ? (double)stats.numKeys / (stats.numLeaves * (B_PLUS_TREE_ORDER - 1)) : 0.0, 
+               stats.numKeys > 0 ? (double)(stats.numNodes * sizeof(BPlusTreeNode)) / stats.numKeys : 0.0, 
+               valid ? "true" : "false", d == NUM_KEY_DISTRIBUTIONS - 1 ? "" : ",");
+        
+        poolReset(&treeNodePool);
     }
+    printf("  ]\n}\n");
     
-    // Load customers
-    file = fopen(CUSTOMER_DATA_FILE, "r");
-    if (file) {
-        while (fgets(line, sizeof(line), file)) {
-            line[strcspn(line, "\r\n")] = 0;  // Remove newline
-            
-            Customer cust;
-            memset(&cust, 0, sizeof(Customer));
-            
-            char* token = strtok(line, ",");
-            if (token) strcpy(cust.id, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(cust.name, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(cust.mobileNo, token);
-            
-            token = strtok(NULL, ",");
-            if (token) strcpy(cust.address, token);
-            
-            token = strtok(NULL, ",");
-            if (token) cust.numPurchasedCars = atoi(token);
-            
-            for (int i = 0; i < cust.numPurchasedCars && i < 10; i++) {
-                token = strtok(NULL, ",");
-                if (token) strcpy(cust.purchasedCars[i], token);
-            }
-            
-            // Add customer to list and tree
-            CustomerNode* newNode = (CustomerNode*)malloc(sizeof(CustomerNode));
-            if (newNode) {
-                memcpy(&newNode->customer, &cust, sizeof(Customer));
-                newNode->next = customerList;
-                customerList = newNode;
-                
-                insertIntoTree(&customerTree, cust.id, (void*)newNode);
+    free(lookups);
+    free(keys);
+    return allValid ? 0 : 1;
+}
+
+// Tree stress test
+// Builds one tree of VINs and one of customer IDs from many threads at once.
+// Each thread inserts its share of the keys (interleaved with the others, so
+// threads keep splitting the same nodes), looks each one up straight after,
+// looks up random keys of other threads, and deletes every
+// STRESS_TREE_DELETE_EVERY-th of its keys again. Afterwards the tree must pass
+// validateTree and hold exactly the keys that were not deleted. A last pass
+// times lookups on 1, 2, 4, ... threads to show how reads scale.
+static bool stressKeyDeleted(size_t index, size_t numThreads) {
+    return index > 0 && (index / numThreads) % STRESS_TREE_DELETE_EVERY == STRESS_TREE_DELETE_EVERY - 1;
+}
+
+static void* stressTreeWorker(void* arg) {
+    StressWorker* worker = (StressWorker*)arg;
+    uint64_t state = GENERATOR_SEED + worker->thread;
+    
+    // The tree starts empty, so the threads also race to create the root
+    for (size_t i = worker->thread; i < worker->numKeys; i += worker->numThreads) {
+        void* value = (void*)(uintptr_t)(i + 1);
+        insertKeyIntoTree(worker->rootPtr, worker->keys[i], value);
+        BPlusTreeNode* root = __atomic_load_n(worker->rootPtr, __ATOMIC_ACQUIRE);
+        if (searchKey(root, worker->keys[i]) != value) {
+            worker->errors++;
+        }
+        
+        size_t other = nextRandom(&state) % worker->numKeys;
+        void* found = searchKey(root, worker->keys[other]);
+        if (found && found != (void*)(uintptr_t)(other + 1)) {
+            worker->errors++;
+        }
+        
+        if (stressKeyDeleted(i, worker->numThreads)) {
+            if (!deleteKeyFromTree(root, worker->keys[i]) || searchKey(root, worker->keys[i])) {
+                worker->errors++;
             }
         }
-        fclose(file);
+        worker->operations += 3;
     }
+    return NULL;
 }
 
-void initializeTrees() {
-    carVinTree = NULL;
-    salesPersonTree = NULL;
-    customerTree = NULL;
-    carSalesTree = NULL;
-    
-    // Showroom-specific trees will be initialized in loadDataFromFiles
+static void* stressLookupWorker(void* arg) {
+    StressWorker* worker = (StressWorker*)arg;
+    uint64_t state = GENERATOR_SEED + worker->thread;
+    BPlusTreeNode* root = *worker->rootPtr;
+    for (size_t i = 0; i < worker->operations; i++) {
+        size_t index = nextRandom(&state) % worker->numKeys;
+        void* expected = stressKeyDeleted(index, worker->numThreads) ? NULL : (void*)(uintptr_t)(index + 1);
+        if (searchKey(root, worker->keys[index]) != expected) {
+            worker->errors++;
+        }
+    }
+    return NULL;
 }
 
-void addCar(Car* car) {
-    // Generate a new VIN if not provided
-    if (strlen(car->VIN) == 0) {
-        char* vin = createNewId("CAR");
-        strcpy(car->VIN, vin);
-        free(vin);
+// Run task on numThreads threads, or on this one for any that fail to start
+static void runStressThreads(StressWorker* workers, size_t numThreads, void* (*task)(void*)) {
+    pthread_t threads[MAX_WORKER_THREADS];
+    bool started[MAX_WORKER_THREADS];
+    for (size_t t = 0; t < numThreads; t++) {
+        started[t] = pthread_create(&threads[t], NULL, task, &workers[t]) == 0;
     }
+    for (size_t t = 0; t < numThreads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        } else {
+            task(&workers[t]);
+        }
+    }
+}
+
+int runTreeStressTest(size_t numThreads, size_t numKeys) {
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > MAX_WORKER_THREADS) numThreads = MAX_WORKER_THREADS;
+    if (numKeys < 1) numKeys = 1;
     
-    // Create a new car node
-    CarNode* newNode = (CarNode*)malloc(sizeof(CarNode));
-    if (!newNode) {
+    uint64_t state = GENERATOR_SEED;
+    char (*keyStrings)[KEY_BYTES + 1] = (char (*)[KEY_BYTES + 1])malloc(numKeys * (KEY_BYTES + 1));
+    BPlusKey* keys = (BPlusKey*)malloc(numKeys * sizeof(BPlusKey));
+    if (!keyStrings || !keys) {
         fprintf(stderr, "Memory allocation failed\n");
-        return;
+        exit(1);
     }
     
-    // Copy the car data
-    memcpy(&newNode->car, car, sizeof(Car));
-    
-    // Insert into linked list
-    newNode->next = carList;
-    carList = newNode;
-    
-    // Insert into main B+ tree
-    insertIntoTree(&carVinTree, car->VIN, (void*)newNode);
+    static const KeyDistribution distributions[] = { KEYS_RANDOM, KEYS_PREFIX_HEAVY };
+    static const char* const treeNames[] = { "vin", "customerId" };
+    const size_t numTrees = sizeof(distributions) / sizeof(distributions[0]);
+    StressWorker workers[MAX_WORKER_THREADS];
+    bool allValid = true;
     
-    // Insert into showroom-specific tree
-    for (int i = 0; i < numShowrooms; i++) {
-        if (strcmp(showrooms[i].id, car->showroomId) == 0) {
-            insertIntoTree(&showroomCarTrees[i], car->VIN, (void*)newNode);
-            break;
+    printf("{\n");
+    printf("  \"order\": %d, \"threads\": %zu, \"keys\": %zu,\n", B_PLUS_TREE_ORDER, numThreads, numKeys);
+    printf("  \"trees\": [\n");
+    for (size_t d = 0; d < numTrees; d++) {
+        makeBenchKeys(keyStrings, numKeys, distributions[d], &state);
+        for (size_t i = 0; i < numKeys; i++) {
+            keys[i] = makeStringKey(keyStrings[i]);
+        }
+        
+        BPlusTreeNode* root = NULL;
+        memset(workers, 0, sizeof(workers));
+        for (size_t t = 0; t < numThreads; t++) {
+            workers[t].rootPtr = &root;
+            workers[t].keys = keys;
+            workers[t].numKeys = numKeys;
+            workers[t].thread = t;
+            workers[t].numThreads = numThreads;
+        }
+        double start = benchSeconds();
+        runStressThreads(workers, numThreads, stressTreeWorker);
+        double seconds = benchSeconds() - start;
+        
+        size_t errors = 0;
+        size_t operations = 0;
+        for (size_t t = 0; t < numThreads; t++) {
+            errors += workers[t].errors;
+            operations += workers[t].operations;
+        }
+        if (errors > 0) {
+            fprintf(stderr, "Invalid tree: %zu lookups or deletes went wrong while threads were inserting\n", errors);
+        }
+        
+        // Single-threaded check of the finished tree
+        TreeStats stats;
+        bool valid = validateTree(root, &stats) && errors == 0;
+        size_t expected = 0;
+        size_t wrong = 0;
+        for (size_t i = 0; i < numKeys; i++) {
+            bool deleted = stressKeyDeleted(i, numThreads);
+            expected += !deleted;
+            wrong += searchKey(root, keys[i]) != (deleted ? NULL : (void*)(uintptr_t)(i + 1));
+        }
+        if (valid && (stats.numKeys != expected || wrong > 0)) {
+            fprintf(stderr, "Invalid tree: %zu keys in the leaves, %zu expected, %zu wrong values\n", 
+                    stats.numKeys, expected, wrong);
+            valid = false;
+        }
+        allValid = allValid && valid;
+        
+        printf("    {\"tree\": \"%s\", \"opsPerSec\": %.0f, \"height\": %zu, \"nodes\": %zu, \"keys\": %zu, "
+               "\"valid\": %s,\n", 
+               treeNames[d], seconds > 0 ? operations / seconds : 0.0, stats.height, stats.numNodes, stats.numKeys, 
+               valid ? "true" : "false");
+        
+        // The same number of lookups in total, spread over more and more threads
+        printf("     \"lookupScaling\": [");
+        size_t threads = 1;
+        while (true) {
+            for (size_t t = 0; t < threads; t++) {
+                workers[t].operations = numKeys / threads;
+                workers[t].errors = 0;
+            }
+            start = benchSeconds();
+            runStressThreads(workers, threads, stressLookupWorker);
+            seconds = benchSeconds() - start;
+            
+            size_t lookupErrors = 0;
+            for (size_t t = 0; t < threads; t++) {
+                lookupErrors += workers[t].errors;
+            }
+            if (lookupErrors > 0) {
+                fprintf(stderr, "Invalid tree: %zu lookups on %zu threads went wrong\n", lookupErrors, threads);
+                allValid = false;
+            }
+            printf("%s{\"threads\": %zu, \"lookupsPerSec\": %.0f}", threads > 1 ? ", " : "", 
+                   threads, seconds > 0 ? (threads * (numKeys / threads)) / seconds : 0.0);
+            if (threads == numThreads) break;
+            threads = threads * 2 < numThreads ? threads * 2 : numThreads;
         }
+        printf("]}%s\n", d == numTrees - 1 ? "" : ",");
+        
+        poolReset(&treeNodePool);
     }
+    printf("  ]\n}\n");
     
-    // Save to file
-    saveCarToFile(car);
-    
-    printf("Car added with VIN: %s\n", car->VIN);
+    free(keys);
+    free(keyStrings);
+    return allValid ? 0 : 1;
 }
 
-void addCustomer(Customer* customer) {
-    // Generate a new ID if not provided
-    if (strlen(customer->id) == 0) {
-        char* id = createNewId("CUST");
-        strcpy(customer->id, id);
-        free(id);
+int main(int argc, char* argv[]) {
+    const char* scriptFile = NULL;
+    const char* socketPath = NULL;
+    bool benchmark = false;
+    size_t benchLookups = BENCH_LOOKUPS;
+    if (argc == 3 && strcmp(argv[1], "--script") == 0) {
+        scriptFile = argv[2];
+    } else if ((argc == 2 || argc == 3) && strcmp(argv[1], "--server") == 0) {
+        socketPath = argc == 3 ? argv[2] : SERVER_SOCKET_PATH;
+    } else if (argc >= 2 && argc <= 6 && strcmp(argv[1], "--generate") == 0) {
+        DatasetSize size = { 100000, 10000, 1000, 10 };
+        size_t* counts[] = { &size.cars, &size.customers, &size.salesPersons, &size.showrooms };
+        for (int i = 2; i < argc; i++) {
+            *counts[i - 2] = strtoull(argv[i], NULL, 10);
+        }
+        return generateDataset(&size) ? 0 : 1;
+    } else if ((argc == 2 || argc == 3) && strcmp(argv[1], "--bench-tree") == 0) {
+        return runTreeBenchmark(argc == 3 ? strtoull(argv[2], NULL, 10) : TREE_BENCH_KEYS);
+    } else if (argc >= 2 && argc <= 4 && strcmp(argv[1], "--stress-tree") == 0) {
+        return runTreeStressTest(argc >= 3 ? strtoull(argv[2], NULL, 10) : STRESS_TREE_THREADS, 
+                                 argc == 4 ? strtoull(argv[3], NULL, 10) : STRESS_TREE_KEYS);
+    } else if ((argc == 2 || argc == 3) && strcmp(argv[1], "--bench") == 0) {
+        benchmark = true;
+        if (argc == 3) benchLookups = strtoull(argv[2], NULL, 10);
+    } else if (argc != 1) {
+        fprintf(stderr, "Usage: %s [--script file|-]\n"
+                        "       %s --server [socketPath]\n"
+                        "       %s --generate [cars [customers [salespersons [showrooms]]]]\n"
+                        "       %s --bench [lookups]\n"
+                        "       %s --bench-tree [keys]\n"
+                        "       %s --stress-tree [threads [keys]]\n", argv[0], argv[0], argv[0], argv[0], argv[0], argv[0]);
+        return 1;
     }
-    
-    // Create a new customer node
-    CustomerNode* newNode = (CustomerNode*)malloc(sizeof(CustomerNode));
-    if (!newNode) {
-        fprintf(stderr, "Memory allocation failed\n");
-        return;
+    if (scriptFile) {
+        setvbuf(stdout, NULL, _IOFBF, SCRIPT_OUTPUT_BUFFER);
     }
     
-    // Copy the customer data
-    memcpy(&newNode->customer, customer, sizeof(Customer));
-    
-    // Insert into linked list
-    newNode->next = customerList;
-    customerList = newNode;
-    
-    // Insert into B+ tree
-    insertIntoTree(&customerTree, customer->id, (void*)newNode);
-    
-    // Save to file
-    saveCustomerToFile(customer);
-    
-    printf("Customer added with ID: %s\n", customer->id);
-}
-
-int main() {
     // Initialize file system
     ensureFilesExist();
     
     // Initialize data structures
     initializeTrees();
+    initializeCarDictionaries();
+    
+    if (benchmark) {
+        runBenchmarks(benchLookups);  // Times the load itself
+        closeJournal();
+        freeMemory();
+        return 0;
+    }
     
     // Load existing data
     loadDataFromFiles();
+    replayJournal();
+    
+    if (scriptFile) {
+        size_t numErrors = runScript(scriptFile);
+        metricsTick(true);
+        closeJournal();
+        freeMemory();
+        return numErrors > 0 ? 1 : 0;
+    }
+    
+    if (socketPath) {
+        int status = runServer(socketPath);
+        metricsTick(true);
+        closeJournal();
+        freeMemory();
+        return status;
+    }
     
     int choice;
     char VIN[MAX_STRING];
@@ -1276,6 +7123,7 @@ int main() {
     double minSales, maxSales;
     int minMonths, maxMonths;
     char outputFileName[MAX_STRING];
+    char showroomId[MAX_STRING];
     
     do {
         printf("\n===== Car Dealership Management System =====\n");
@@ -1290,47 +7138,70 @@ int main() {
         printf("9. List customers by EMI range\n");
         printf("10. Predict next month sales\n");
         printf("11. Merge showroom data to file\n");
-        printf("12. Exit\n");
+        printf("12. Compact data files\n");
+        printf("13. List cars by VIN prefix\n");
+        printf("14. List showroom inventory\n");
+        printf("15. Car count report\n");
+        printf("16. Salesperson leaderboard\n");
+        printf("17. List cars owned by customer\n");
+        printf("18. Memory pool statistics\n");
+        printf("19. Sell cars from a batch file\n");
+        printf("20. Show metrics\n");
+        printf("21. Showroom dashboard\n");
+        printf("22. Exit\n");
         printf("Enter your choice: ");
-        scanf("%d", &choice);
+        if (scanf("%d", &choice) == EOF) {
+            break;  // Input closed
+        }
         getchar();  // Consume newline
         
         switch (choice) {
             case 1: {
                 Car newCar;
+                char carField[MAX_STRING];
                 memset(&newCar, 0, sizeof(Car));
                 newCar.available = true;
                 
                 printf("Enter car details:\n");
                 printf("VIN (leave empty for auto-generation): ");
-                fgets(newCar.VIN, MAX_STRING, stdin);
-                newCar.VIN[strcspn(newCar.VIN, "\r\n")] = 0;
+                fgets(VIN, MAX_STRING, stdin);
+                VIN[strcspn(VIN, "\r\n")] = 0;
+                if (!validKeyLength(VIN)) {
+                    printf("VIN must be at most %d characters\n", KEY_BYTES);
+                    break;
+                }
+                copyString(newCar.VIN, sizeof(newCar.VIN), VIN);
                 
                 printf("Name: ");
-                fgets(newCar.name, MAX_STRING, stdin);
-                newCar.name[strcspn(newCar.name, "\r\n")] = 0;
+                fgets(carField, MAX_STRING, stdin);
+                carField[strcspn(carField, "\r\n")] = 0;
+                newCar.name = internCarValue(DICT_MODEL, carField);
                 
                 printf("Color: ");
-                fgets(newCar.color, MAX_STRING, stdin);
-                newCar.color[strcspn(newCar.color, "\r\n")] = 0;
+                fgets(carField, MAX_STRING, stdin);
+                carField[strcspn(carField, "\r\n")] = 0;
+                newCar.color = internCarValue(DICT_COLOR, carField);
                 
                 printf("Price: ");
                 scanf("%lf", &newCar.price);
                 getchar();  // Consume newline
                 
                 printf("Fuel Type: ");
-                fgets(newCar.fuelType, MAX_STRING, stdin);
-                newCar.fuelType[strcspn(newCar.fuelType, "\r\n")] = 0;
+                fgets(carField, MAX_STRING, stdin);
+                carField[strcspn(carField, "\r\n")] = 0;
+                newCar.fuelType = internCarValue(DICT_FUEL_TYPE, carField);
                 
                 printf("Body Type (Hatchback/Sedan/SUV): ");
-                fgets(newCar.bodyType, MAX_STRING, stdin);
-                newCar.bodyType[strcspn(newCar.bodyType, "\r\n")] = 0;
+                fgets(carField, MAX_STRING, stdin);
+                carField[strcspn(carField, "\r\n")] = 0;
+                newCar.bodyType = internCarValue(DICT_BODY_TYPE, carField);
                 
                 printf("Showroom ID: ");
-                fgets(newCar.showroomId, MAX_STRING, stdin);
-                newCar.showroomId[strcspn(newCar.showroomId, "\r\n")] = 0;
+                fgets(carField, MAX_STRING, stdin);
+                carField[strcspn(carField, "\r\n")] = 0;
+                newCar.showroomId = internCarValue(DICT_SHOWROOM, carField);
                 
-                addCar(&newCar);
+                addCar(stdout, &newCar);
                 break;
             }
             case 2: {
@@ -1353,31 +7224,40 @@ int main() {
                 printf("Target (in lakhs): ");
                 scanf("%lf", &newSP.target);
                 
-                addNewSalesPerson(&newSP);
+                addNewSalesPerson(stdout, &newSP);
                 break;
             }
             case 3: {
                 Customer newCustomer;
+                char customerField[MAX_STRING];
                 memset(&newCustomer, 0, sizeof(Customer));
                 
                 printf("Enter customer details:\n");
                 printf("ID (leave empty for auto-generation): ");
-                fgets(newCustomer.id, MAX_STRING, stdin);
-                newCustomer.id[strcspn(newCustomer.id, "\r\n")] = 0;
+                fgets(customerId, MAX_STRING, stdin);
+                customerId[strcspn(customerId, "\r\n")] = 0;
+                if (!validKeyLength(customerId)) {
+                    printf("Customer ID must be at most %d characters\n", KEY_BYTES);
+                    break;
+                }
+                copyString(newCustomer.id, sizeof(newCustomer.id), customerId);
                 
                 printf("Name: ");
-                fgets(newCustomer.name, MAX_STRING, stdin);
-                newCustomer.name[strcspn(newCustomer.name, "\r\n")] = 0;
+                fgets(customerField, MAX_STRING, stdin);
+                customerField[strcspn(customerField, "\r\n")] = 0;
+                copyString(newCustomer.name, sizeof(newCustomer.name), customerField);
                 
                 printf("Mobile Number: ");
-                fgets(newCustomer.mobileNo, MAX_STRING, stdin);
-                newCustomer.mobileNo[strcspn(newCustomer.mobileNo, "\r\n")] = 0;
+                fgets(customerField, MAX_STRING, stdin);
+                customerField[strcspn(customerField, "\r\n")] = 0;
+                copyString(newCustomer.mobileNo, sizeof(newCustomer.mobileNo), customerField);
                 
                 printf("Address: ");
-                fgets(newCustomer.address, MAX_STRING, stdin);
-                newCustomer.address[strcspn(newCustomer.address, "\r\n")] = 0;
+                fgets(customerField, MAX_STRING, stdin);
+                customerField[strcspn(customerField, "\r\n")] = 0;
+                copyString(newCustomer.address, sizeof(newCustomer.address), customerField);
                 
-                addCustomer(&newCustomer);
+                addCustomer(stdout, &newCustomer);
                 break;
             }
             case 4:
@@ -1408,32 +7288,21 @@ int main() {
                     downPayment = 0;
                 }
                 
-                sellCarToCustomer(VIN, customerId, salesPersonId, paymentType, emiMonths, downPayment);
+                sellCarToCustomer(stdout, VIN, customerId, salesPersonId, paymentType, emiMonths, downPayment);
                 break;
             case 5:
                 printf("Enter VIN of car to display: ");
                 fgets(VIN, MAX_STRING, stdin);
                 VIN[strcspn(VIN, "\r\n")] = 0;
                 
-                displayCarInfo(VIN);
+                displayCarInfo(stdout, VIN);
                 break;
-            case 6: {
-                char* popularCar = findMostPopularCar();
-                printf("Most popular car: %s\n", popularCar);
-                free(popularCar);
+            case 6:
+                printMostPopularCar(stdout);
                 break;
-            }
-            case 7: {
-                SalesPerson* bestSP = findMostSuccessfulSalesPerson();
-                if (bestSP) {
-                    printf("Most successful salesperson: %s (%.2f lakhs)\n", 
-                           bestSP->name, bestSP->achieved);
-                    printf("Incentive: %.2f lakhs\n", bestSP->achieved * 0.01); // Print the incentive
-                } else {
-                    printf("No salespeople found in the system\n");
-                }
+            case 7:
+                printMostSuccessfulSalesPerson(stdout);
                 break;
-            }
             case 8:
                 printf("Enter minimum sales (in lakhs): ");
                 scanf("%lf", &minSales);
@@ -1441,30 +7310,116 @@ int main() {
                 printf("Enter maximum sales (in lakhs): ");
                 scanf("%lf", &maxSales);
                 
-                findSalesPersonByTargetRange(minSales, maxSales);
+                findSalesPersonByTargetRange(stdout, minSales, maxSales);
                 break;
             case 9:
-            // Call the function with the specific range for EMI
-            listCustomersByEmiRange(36, 48);
-            break;
+                printf("Enter minimum EMI months (exclusive): ");
+                scanf("%d", &minMonths);
+                
+                printf("Enter maximum EMI months (exclusive): ");
+                scanf("%d", &maxMonths);
+                
+                listCustomersByEmiRange(stdout, minMonths, maxMonths);
+                break;
             case 10:
-                predictNextMonthSales();
+                predictNextMonthSales(stdout);
                 break;
             case 11:
                 printf("Enter output file name: ");
                 fgets(outputFileName, MAX_STRING, stdin);
                 outputFileName[strcspn(outputFileName, "\r\n")] = 0;
                 
-                mergeShowrooms(outputFileName);
+                mergeShowrooms(stdout, outputFileName);
                 break;
             case 12:
+                compactDataFiles();
+                printf("Data files compacted\n");
+                break;
+            case 13:
+                printf("Enter VIN prefix (e.g. CAR0*): ");
+                fgets(VIN, MAX_STRING, stdin);
+                VIN[strcspn(VIN, "\r\n")] = 0;
+                
+                listCarsByVinPrefix(stdout, VIN);
+                break;
+            case 14:
+                printf("Enter showroom ID: ");
+                fgets(showroomId, MAX_STRING, stdin);
+                showroomId[strcspn(showroomId, "\r\n")] = 0;
+                
+                listShowroomInventory(stdout, showroomId);
+                break;
+            case 15: {
+                int field;
+                int topCount;
+                printf("Group by (0=Model, 1=Color, 2=Fuel Type, 3=Body Type, 4=Showroom): ");
+                scanf("%d", &field);
+                
+                printf("Number of entries to show: ");
+                scanf("%d", &topCount);
+                
+                if (field < GROUP_BY_MODEL || field > GROUP_BY_SHOWROOM || topCount < 1) {
+                    printf("Invalid report options\n");
+                    break;
+                }
+                printCarGroupReport(stdout, (CarGroupField)field, (size_t)topCount);
+                break;
+            }
+            case 16: {
+                int topCount;
+                printf("Showroom ID (leave empty for all showrooms): ");
+                fgets(showroomId, MAX_STRING, stdin);
+                showroomId[strcspn(showroomId, "\r\n")] = 0;
+                
+                printf("Number of entries to show: ");
+                scanf("%d", &topCount);
+                
+                if (topCount < 1) {
+                    printf("Invalid number of entries\n");
+                    break;
+                }
+                printSalesLeaderboard(stdout, showroomId[0] ? showroomId : NULL, (size_t)topCount);
+                break;
+            }
+            case 17:
+                printf("Enter customer ID: ");
+                fgets(customerId, MAX_STRING, stdin);
+                customerId[strcspn(customerId, "\r\n")] = 0;
+                
+                listCustomerCars(stdout, customerId);
+                break;
+            case 18:
+                printPoolStats(stdout);
+                break;
+            case 19:
+                printf("Enter batch file name (VIN,customerId,salespersonId,paymentType,emiMonths,downPayment per line): ");
+                fgets(outputFileName, MAX_STRING, stdin);
+                outputFileName[strcspn(outputFileName, "\r\n")] = 0;
+                
+                sellCarsFromFile(stdout, outputFileName);
+                break;
+            case 20:
+                printMetrics(stdout);
+                break;
+            case 21:
+                printf("Showroom ID (leave empty for all showrooms): ");
+                fgets(showroomId, MAX_STRING, stdin);
+                showroomId[strcspn(showroomId, "\r\n")] = 0;
+                
+                printShowroomDashboard(stdout, showroomId[0] ? showroomId : NULL);
+                break;
+            case 22:
                 printf("Exiting...\n");
                 break;
             default:
                 printf("Invalid choice. Please try again.\n");
         }
-    } while (choice != 12);
+        compactIfDue();
+        metricsTick(false);
+    } while (choice != 22);
     
+    metricsTick(true);
+    closeJournal();
     freeMemory();
     return 0;
 }
\ No newline at end of file